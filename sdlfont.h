@@ -40,8 +40,13 @@ typedef uint8_t FontBitmap[FONT_HEIGHT];
 
 void sdlfont_init(void);
 int  sdlfont_load_psf(const char *path);
+int  sdlfont_load_cache(const char *path);
+int  sdlfont_font_count(void);
+int  sdlfont_set_font_order(const int *order, int count);
 void sdlfont_generate_char_bitmap(FontBitmap bitmap, uint32_t c);
-void sdlfont_draw_char(int x, int y, FontBitmap bitmap, SDL_Renderer *renderer);
+const uint8_t *sdlfont_glyph(uint32_t c);
+void sdlfont_draw_char(int x, int y, const uint8_t *bitmap, SDL_Renderer *renderer);
 void sdlfont_draw_string(int x, int y, const char *str, SDL_Renderer *renderer);
+void sdlfont_free_atlas(void);
 
 #endif
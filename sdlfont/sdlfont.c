@@ -32,7 +32,7 @@
 Как это работает.
 
     С -DUSE_UNICODE и PSF не найден:
-        psf_font_data == NULL, проверка c <= 255 && psf_font_data не срабатывает.
+        Цепочка шрифтов пуста, PSF не используется.
         Всё (ASCII и кириллица) берётся из sdlfont_unicode.h.
         switch не используется.
 
@@ -44,6 +44,21 @@
         Если PSF загружен, он используется для 0–255.
         Если PSF не найден, только встроенный ASCII (switch).
 
+    Если в PSF (PSF1 или PSF2) есть таблица Unicode, PSF используется для
+    всех кодовых точек из этой таблицы, а не для 0–255. Остальные
+    символы по-прежнему берутся из sdlfont_unicode.h и встроенного ASCII.
+
+    Кэш шрифта (sdlfont_load_cache) заменяет sdlfont_unicode.h без
+    компиляции таблицы в программу.
+
+    Загруженные шрифты (PSF и кэши) образуют цепочку: символ берётся из
+    первого шрифта, в котором он есть, в порядке загрузки или в порядке
+    sdlfont_set_font_order. За цепочкой идут sdlfont_unicode.h и встроенный ASCII.
+
+    Эти правила применяются один раз, при изменении цепочки: для каждой
+    кодовой точки запоминается найденный глиф, и при рисовании символ
+    ищется за O(1), без копирования битмапа и без обхода шрифтов.
+
 */
 
 #include "sdlfont.h"
@@ -52,112 +67,628 @@
 #include <string.h>
 #include "sdlgfx.h"
 
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 #ifdef USE_UNICODE
 #include "sdlfont_unicode.h"
 #endif
 
-static uint8_t *psf_font_data = NULL;
-static int psf_font_height = FONT_HEIGHT;
+/*
+    Загруженный шрифт цепочки.
+
+    PSF читается в data целиком, глифы и таблица Unicode используются прямо
+    из этого буфера. Кэш шрифта (sdlfont_load_cache) отображается в память,
+    все числа в нём little-endian:
+
+        "SFNC", версия (1), ширина, высота, число диапазонов, число глифов
+        диапазоны: {первая кодовая точка, длина, первый глиф}, по возрастанию
+        глифы: по FONT_HEIGHT байт, одна строка — один байт
+*/
+#define CACHE_MAGIC       0x434E4653   // "SFNC"
+#define CACHE_VERSION     1
+#define CACHE_HEADER_SIZE 24
+#define CACHE_RANGE_SIZE  12
+
+#define FONT_MAX 8                     // Шрифтов в цепочке
+
+typedef struct {
+    uint8_t *data;             // Файл: прочитанный (PSF) или отображённый (кэш)
+    size_t size;
+    int is_cache;              // Кэш шрифта, иначе PSF
+    const uint8_t *glyphs;     // Первый глиф
+    uint32_t count;            // Глифов в шрифте
+    uint32_t height;           // PSF: строк в глифе
+    uint32_t row_bytes;        // PSF: байт в строке глифа
+    uint32_t glyph_bytes;      // PSF: байт на глиф
+    const uint8_t *unicode;    // PSF: таблица Unicode или NULL
+    const uint8_t *unicode_end;
+    int utf8;                  // PSF: таблица PSF2 (UTF-8), иначе PSF1 (UCS-2)
+    const uint8_t *ranges;     // Кэш: таблица диапазонов
+    uint32_t range_count;
+    uint32_t base;             // Кэш: номер его первого глифа в таблице глифов
+} Font;
+
+static Font fonts[FONT_MAX];   // Цепочка, первый шрифт главнее
+static int font_count = 0;
+
+static void atlas_reset(void);
+static void builtin_char_bitmap(uint8_t *bitmap, uint32_t c);
+
+static uint32_t read_le32(const uint8_t *p) {
+    return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+// Декодирует один символ UTF-8 и сдвигает указатель; invalid — для ошибочной последовательности
+static uint32_t utf8_next(const char **s, uint32_t invalid) {
+    const unsigned char *p = (const unsigned char *)*s;
+    int len = p[0] < 0x80 ? 1 : (p[0] & 0xE0) == 0xC0 ? 2 : (p[0] & 0xF0) == 0xE0 ? 3 : (p[0] & 0xF8) == 0xF0 ? 4 : 0;
+    if (len == 0) {
+        *s += 1;
+        return invalid;
+    }
+    uint32_t c = len == 1 ? p[0] : p[0] & (0x7F >> len);
+    for (int i = 1; i < len; i++) {
+        // Строка кончается нулём, поэтому обрезанная последовательность останавливается здесь
+        if ((p[i] & 0xC0) != 0x80) {
+            *s += 1;
+            return invalid;
+        }
+        c = c << 6 | (p[i] & 0x3F);
+    }
+    *s += len;
+    return c;
+}
+
+/*
+    Таблица глифов.
+
+    Скопированные глифы лежат подряд в glyph_data, по FONT_HEIGHT байт,
+    глифы кэшей — в их отображениях, с номерами от glyph_cache_base.
+    Кодовая точка переводится в номер глифа двухуровневой таблицей страниц:
+    glyph_pages[c >> 8][c & 0xFF], в ней запомнен первый шрифт цепочки, где
+    символ нашёлся. Незаполненные страницы указывают на общую нулевую
+    страницу, а глиф 0 — это '?', так что промах ничего не стоит.
+*/
+
+#define GLYPH_MAX_CODEPOINT 0x10FFFF                        // Последняя кодовая точка Unicode
+#define GLYPH_PAGE_SIZE     256                             // Кодовых точек на странице
+#define GLYPH_PAGES         ((GLYPH_MAX_CODEPOINT >> 8) + 1)
+
+static uint8_t *glyph_data = NULL;                   // Глифы подряд, глиф 0 — '?'
+static int glyph_count = 0;                          // Заполненных глифов
+static uint32_t glyph_cache_base = 0;                // Номер первого глифа кэшей
+static uint32_t *glyph_pages[GLYPH_PAGES];           // Страницы номеров глифов
+static uint32_t glyph_empty_page[GLYPH_PAGE_SIZE];   // Общая страница без глифов
+static uint16_t *glyph_cells = NULL;                 // Ячейка атласа + 1 для каждого глифа
+static uint32_t glyph_cell_count = 0;
+static const uint8_t glyph_blank[FONT_HEIGHT];       // Если таблицу не удалось выделить
+
+static void glyph_table_free(void) {
+    for (int i = 0; i < GLYPH_PAGES; i++) {
+        if (glyph_pages[i] != glyph_empty_page) free(glyph_pages[i]);
+        glyph_pages[i] = glyph_empty_page;
+    }
+    free(glyph_data);
+    free(glyph_cells);
+    glyph_data = NULL;
+    glyph_cells = NULL;
+    glyph_count = 0;
+    glyph_cache_base = 0;
+    glyph_cell_count = 0;
+}
+
+// Строки глифа: номера до glyph_cache_base лежат в glyph_data, дальше — в кэшах
+static const uint8_t *glyph_rows(uint32_t index) {
+    if (index < glyph_cache_base) return &glyph_data[index * FONT_HEIGHT];
+    const Font *font = fonts;
+    while (!font->is_cache || index - font->base >= font->count) font++;
+    return &font->glyphs[(index - font->base) * FONT_HEIGHT];
+}
+
+// Элемент страницы для кодовой точки, страница выделяется при первой записи
+static uint32_t *glyph_slot(uint32_t c) {
+    if (c > GLYPH_MAX_CODEPOINT) return NULL;
+    uint32_t *page = glyph_pages[c >> 8];
+    if (page == glyph_empty_page) {
+        page = calloc(GLYPH_PAGE_SIZE, sizeof(uint32_t));
+        if (!page) return NULL; // Символ останется '?'
+        glyph_pages[c >> 8] = page;
+    }
+    return &page[c & 0xFF];
+}
+
+// Связывает кодовую точку с глифом, если у неё его ещё нет: первый источник главнее
+static void glyph_map(uint32_t c, uint32_t index) {
+    uint32_t *slot = glyph_slot(c);
+    if (slot && !*slot) *slot = index;
+}
+
+// Копирует глиф в таблицу для кодовой точки без глифа
+static void glyph_add(uint32_t c, const uint8_t *rows) {
+    uint32_t *slot = glyph_slot(c);
+    if (!slot || *slot) return;
+    memcpy(&glyph_data[glyph_count * FONT_HEIGHT], rows, FONT_HEIGHT);
+    *slot = glyph_count++;
+}
+
+// Копирует глифы PSF в таблицу и связывает их с кодовыми точками
+static void glyph_add_psf(const Font *font) {
+    uint32_t first = glyph_count;
+    uint32_t count = font->unicode ? font->count : (font->count < 256 ? font->count : 256);
+    for (uint32_t i = 0; i < count; i++) {
+        const uint8_t *src = font->glyphs + i * font->glyph_bytes;
+        uint8_t *dst = &glyph_data[(first + i) * FONT_HEIGHT];
+        // Ширина не больше FONT_WIDTH, значит нужен только первый байт строки
+        for (uint32_t row = 0; row < font->height; row++) dst[row] = src[row * font->row_bytes];
+    }
+    glyph_count += count;
+
+    if (!font->unicode) {
+        for (uint32_t c = 0; c < count; c++) glyph_map(c, first + c);
+        return;
+    }
+
+    // Для каждого глифа: список кодовых точек, затем последовательности
+    // (составные символы, их не рисуем) и ограничитель
+    const uint8_t *p = font->unicode;
+    for (uint32_t i = 0; i < font->count && p < font->unicode_end; i++) {
+        int sequence = 0;
+        if (font->utf8) {
+            while (p < font->unicode_end && *p != 0xFF) {
+                if (*p == 0xFE) {
+                    sequence = 1;
+                    p++;
+                    continue;
+                }
+                const char *q = (const char *)p;
+                uint32_t c = utf8_next(&q, 0xFFFFFFFF);
+                p = (const uint8_t *)q;
+                if (!sequence && c != 0xFFFFFFFF) glyph_map(c, first + i);
+            }
+            p++;
+        } else {
+            while (p + 1 < font->unicode_end) {
+                uint32_t c = p[0] | p[1] << 8;
+                p += 2;
+                if (c == 0xFFFF) break;
+                if (c == 0xFFFE) sequence = 1;
+                else if (!sequence) glyph_map(c, first + i);
+            }
+        }
+    }
+}
+
+// Связывает кодовые точки кэша с его глифами, сами глифы не копируются
+static void glyph_add_cache(const Font *font) {
+    for (uint32_t i = 0; i < font->range_count; i++) {
+        const uint8_t *range = font->ranges + i * CACHE_RANGE_SIZE;
+        uint32_t first = read_le32(range), count = read_le32(range + 4), glyph = read_le32(range + 8);
+        if (glyph > font->count || count > font->count - glyph) continue; // Повреждённый диапазон
+        for (uint32_t k = 0; k < count; k++) glyph_map(first + k, font->base + glyph + k);
+    }
+}
+
+// Собирает таблицу из цепочки шрифтов, sdlfont_unicode.h и встроенного ASCII в порядке приоритета
+static void glyph_table_build(void) {
+    glyph_table_free();
+
+    uint32_t capacity = 1 + ('~' - ' ' + 1);
+#ifdef USE_UNICODE
+    capacity += font_data_size;
+#endif
+    for (int i = 0; i < font_count; i++) {
+        if (!fonts[i].is_cache) capacity += fonts[i].count;
+    }
+    uint32_t total = capacity; // Глифы кэшей нумеруются после скопированных
+    for (int i = 0; i < font_count; i++) {
+        if (!fonts[i].is_cache) continue;
+        fonts[i].base = total;
+        total += fonts[i].count;
+    }
+    glyph_data = calloc(capacity, FONT_HEIGHT); // Нули дополняют глифы PSF ниже FONT_HEIGHT
+    glyph_cells = calloc(total, sizeof(uint16_t));
+    glyph_cell_count = total;
+    glyph_cache_base = capacity;
+    if (!glyph_data || !glyph_cells) {
+        fprintf(stderr, "sdlfont: Failed to allocate the glyph table.\n");
+        glyph_table_free();
+        return;
+    }
+    glyph_count = 1; // Глиф 0 заполняется в конце
+
+    for (int i = 0; i < font_count; i++) {
+        if (fonts[i].is_cache) glyph_add_cache(&fonts[i]);
+        else glyph_add_psf(&fonts[i]);
+    }
+#ifdef USE_UNICODE
+    for (int i = 0; i < font_data_size; i++) {
+        glyph_add(font_data[i].codepoint, font_data[i].bitmap);
+    }
+#endif
+    for (uint32_t c = ' '; c <= '~'; c++) {
+        FontBitmap bitmap;
+        builtin_char_bitmap(bitmap, c);
+        glyph_add(c, bitmap);
+    }
+
+    // Все промахи рисуются вопросительным знаком текущего шрифта
+    memcpy(glyph_data, glyph_rows(glyph_pages[0]['?']), FONT_HEIGHT);
+    atlas_reset(); // Глифы в атласе нарисованы старым шрифтом
+}
+
+// Номер глифа кодовой точки, 0 ('?') если его нет
+static uint32_t glyph_index(uint32_t c) {
+    if (!glyph_data) glyph_table_build();
+    if (c > GLYPH_MAX_CODEPOINT) return 0;
+    return glyph_pages[c >> 8][c & 0xFF];
+}
+
+const uint8_t *sdlfont_glyph(uint32_t c) {
+    uint32_t index = glyph_index(c);
+    return glyph_data ? glyph_rows(index) : glyph_blank;
+}
+
+static void font_free(Font *font) {
+#ifndef _WIN32
+    if (font->is_cache) {
+        munmap(font->data, font->size);
+        return;
+    }
+#endif
+    free(font->data);
+}
 
 void sdlfont_init(void) {
-    if (psf_font_data) {
-        free(psf_font_data);
-        psf_font_data = NULL;
+    for (int i = 0; i < font_count; i++) font_free(&fonts[i]);
+    font_count = 0;
+    glyph_table_build();
+}
+
+// Ставит разобранный шрифт в конец цепочки; при ошибке освобождает его
+static int font_append(Font *font, const char *path) {
+    if (font_count == FONT_MAX) {
+        fprintf(stderr, "sdlfont: %s: the font chain already holds %d fonts.\n", path, FONT_MAX);
+        font_free(font);
+        return 0;
     }
-    psf_font_height = FONT_HEIGHT;
+    fonts[font_count++] = *font;
+    glyph_table_build();
+    return 1;
+}
+
+int sdlfont_font_count(void) {
+    return font_count;
+}
+
+int sdlfont_set_font_order(const int *order, int count) {
+    if (!order || count != font_count) return 0;
+    Font sorted[FONT_MAX];
+    int used = 0;
+    for (int i = 0; i < count; i++) {
+        if (order[i] < 0 || order[i] >= font_count || (used & (1 << order[i]))) return 0;
+        used |= 1 << order[i];
+        sorted[i] = fonts[order[i]];
+    }
+    memcpy(fonts, sorted, count * sizeof(Font));
+    glyph_table_build();
+    return 1;
+}
+
+// Разбирает заголовок PSF1 или PSF2; 0 — если это не PSF или глифы не помещаются в ячейку
+static int psf_parse(Font *font, const uint8_t *data, size_t size) {
+    uint32_t header_size, width;
+    int has_table;
+
+    if (size >= 4 && data[0] == 0x36 && data[1] == 0x04) {
+        // PSF1: 256 или 512 глифов шириной 8, таблица из UCS-2
+        header_size = 4;
+        width = 8;
+        font->count = (data[2] & 0x01) ? 512 : 256;
+        font->height = data[3];
+        font->row_bytes = 1;
+        font->glyph_bytes = font->height;
+        font->utf8 = 0;
+        has_table = (data[2] & 0x06) != 0;
+    } else if (size >= 32 && read_le32(data) == 0x864AB572) {
+        // PSF2: размеры в заголовке, таблица из UTF-8
+        header_size = read_le32(data + 8);
+        font->count = read_le32(data + 16);
+        font->glyph_bytes = read_le32(data + 20);
+        font->height = read_le32(data + 24);
+        width = read_le32(data + 28);
+        font->row_bytes = (width + 7) / 8;
+        font->utf8 = 1;
+        has_table = (read_le32(data + 12) & 0x01) != 0;
+        if (header_size < 32 || font->glyph_bytes < (uint64_t)font->height * font->row_bytes) return 0;
+    } else {
+        return 0;
+    }
+
+    if (width == 0 || width > FONT_WIDTH || font->height == 0 || font->height > FONT_HEIGHT) {
+        fprintf(stderr, "sdlfont: %ux%u PSF glyphs do not fit the %dx%d cell.\n",
+                (unsigned)width, (unsigned)font->height, FONT_WIDTH, FONT_HEIGHT);
+        return 0;
+    }
+    uint64_t glyphs_end = header_size + (uint64_t)font->count * font->glyph_bytes;
+    if (font->count == 0 || glyphs_end > size) return 0;
+
+    font->glyphs = data + header_size;
+    font->unicode = has_table ? data + glyphs_end : NULL;
+    font->unicode_end = data + size;
+    return 1;
 }
 
 int sdlfont_load_psf(const char *path) {
     FILE *f = fopen(path, "rb");
     if (!f) return 0;
 
-    uint8_t header[4];
-    if (fread(header, 1, 4, f) != 4) {
+    // Весь файл одним чтением, без выделения памяти под отдельные глифы
+    long size = -1;
+    if (fseek(f, 0, SEEK_END) == 0) size = ftell(f);
+    if (size < 4 || fseek(f, 0, SEEK_SET) != 0) {
         fclose(f);
         return 0;
     }
 
-    if (header[0] != 0x36 || header[1] != 0x04) {
+    uint8_t *data = malloc((size_t)size + 1);
+    if (!data) {
         fclose(f);
         return 0;
     }
 
-    int mode = header[2];
-    int charsize = header[3];
-
-    int font_size = 256 * charsize;
-    psf_font_data = malloc(font_size);
-    if (!psf_font_data) {
+    if (fread(data, 1, (size_t)size, f) != (size_t)size) {
+        free(data);
         fclose(f);
         return 0;
     }
+    fclose(f);
+    data[size] = 0; // UTF-8 в таблице PSF2 не прочитается за конец буфера
 
-    if (fread(psf_font_data, 1, font_size, f) != font_size) {
-        free(psf_font_data);
-        psf_font_data = NULL;
-        fclose(f);
+    Font font = {0};
+    if (!psf_parse(&font, data, (size_t)size)) {
+        free(data);
         return 0;
     }
+    font.data = data;
+    font.size = (size_t)size;
+    return font_append(&font, path);
+}
 
-    psf_font_height = charsize;
+// Отображает файл в память только для чтения; без mmap читает его целиком
+static uint8_t *cache_map_file(const char *path, size_t *size) {
+#ifndef _WIN32
+    int fd = open(path, O_RDONLY);
+    if (fd < 0) return NULL;
+    struct stat st;
+    void *map = MAP_FAILED;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+        map = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    }
+    close(fd); // Отображение держит файл само
+    if (map == MAP_FAILED) return NULL;
+    *size = (size_t)st.st_size;
+    return map;
+#else
+    FILE *f = fopen(path, "rb");
+    if (!f) return NULL;
+    long length = -1;
+    if (fseek(f, 0, SEEK_END) == 0) length = ftell(f);
+    uint8_t *data = length > 0 ? malloc((size_t)length) : NULL;
+    if (!data || fseek(f, 0, SEEK_SET) != 0 || fread(data, 1, (size_t)length, f) != (size_t)length) {
+        free(data);
+        fclose(f);
+        return NULL;
+    }
     fclose(f);
+    *size = (size_t)length;
+    return data;
+#endif
+}
+
+int sdlfont_load_cache(const char *path) {
+    size_t size = 0;
+    uint8_t *map = cache_map_file(path, &size);
+    if (!map) return 0;
+
+    uint32_t width = 0, height = 0, ranges = 0, glyphs = 0;
+    if (size >= CACHE_HEADER_SIZE && read_le32(map) == CACHE_MAGIC && read_le32(map + 4) == CACHE_VERSION) {
+        width = read_le32(map + 8);
+        height = read_le32(map + 12);
+        ranges = read_le32(map + 16);
+        glyphs = read_le32(map + 20);
+    }
+    uint64_t glyphs_offset = CACHE_HEADER_SIZE + (uint64_t)ranges * CACHE_RANGE_SIZE;
+    if (width == 0 || width > FONT_WIDTH || height != FONT_HEIGHT ||
+        glyphs_offset + (uint64_t)glyphs * FONT_HEIGHT > size) {
+        fprintf(stderr, "sdlfont: %s is not a valid %dx%d font cache.\n", path, FONT_WIDTH, FONT_HEIGHT);
+        Font font = {.data = map, .size = size, .is_cache = 1};
+        font_free(&font);
+        return 0;
+    }
+
+    Font font = {0};
+    font.data = map;
+    font.size = size;
+    font.is_cache = 1;
+    font.ranges = map + CACHE_HEADER_SIZE;
+    font.range_count = ranges;
+    font.glyphs = map + glyphs_offset;
+    font.count = glyphs;
+    return font_append(&font, path);
+}
+
+void sdlfont_draw_char(int x, int y, const uint8_t *bitmap, SDL_Renderer *renderer) {
+    (void)renderer;
+    // Весь символ за один вызов: строки битмапа разворачивает SIMD-ядро sdlgfx
+    sdlgfx_glyph(x, y, bitmap, FONT_HEIGHT);
+}
+
+/*
+    Атлас глифов для рендерера.
+
+    Каждый символ один раз растеризуется белым по прозрачному в ячейку
+    текстуры, при первом использовании. Строка затем рисуется одним
+    SDL_RenderGeometry (цвет вершин окрашивает глифы) или, на SDL < 2.0.18,
+    одним SDL_RenderCopy на символ с SDL_SetTextureColorMod.
+    Цвет и режим смешивания берутся у рендерера (SDL_SetRenderDrawColor).
+*/
+
+#define ATLAS_COLS  32                          // Ячеек в строке атласа
+#define ATLAS_ROWS  32                          // Строк ячеек
+#define ATLAS_SLOTS (ATLAS_COLS * ATLAS_ROWS)   // Символов в атласе
+#define ATLAS_BATCH 256                         // Символов в одном SDL_RenderGeometry
+
+static SDL_Texture *atlas_texture = NULL;   // Атлас, принадлежит atlas_renderer
+static SDL_Renderer *atlas_renderer = NULL;
+static int atlas_count = 0;                 // Занятых ячеек
+
+// Забывает все ячейки: после смены шрифта или когда атлас заполнен
+static void atlas_reset(void) {
+    if (glyph_cells) memset(glyph_cells, 0, glyph_cell_count * sizeof(uint16_t));
+    atlas_count = 0;
+}
+
+void sdlfont_free_atlas(void) {
+    if (atlas_texture) SDL_DestroyTexture(atlas_texture);
+    atlas_texture = NULL;
+    atlas_renderer = NULL;
+    atlas_reset();
+}
+
+static int atlas_create(SDL_Renderer *renderer) {
+    if (atlas_texture && atlas_renderer == renderer) return 1;
+    sdlfont_free_atlas();
+    atlas_texture = SDL_CreateTexture(renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STATIC,
+                                      ATLAS_COLS * FONT_WIDTH, ATLAS_ROWS * FONT_HEIGHT);
+    if (!atlas_texture) {
+        fprintf(stderr, "sdlfont: Failed to create glyph atlas: %s\n", SDL_GetError());
+        return 0;
+    }
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+    SDL_SetTextureScaleMode(atlas_texture, SDL_ScaleModeNearest); // Без размытия соседних ячеек
+#endif
+    atlas_renderer = renderer;
     return 1;
 }
 
-void sdlfont_draw_char(int x, int y, FontBitmap bitmap, SDL_Renderer *renderer) {
+// Возвращает ячейку глифа, растеризуя его при первом обращении; -1 если атлас полон
+static int atlas_lookup(uint32_t index) {
+    if (glyph_cells[index]) return glyph_cells[index] - 1;
+    if (atlas_count == ATLAS_SLOTS) return -1;
+
+    const uint8_t *bitmap = glyph_rows(index);
+    uint32_t pixels[FONT_WIDTH * FONT_HEIGHT];
     for (int row = 0; row < FONT_HEIGHT; row++) {
-        uint8_t byte = bitmap[row];
         for (int col = 0; col < FONT_WIDTH; col++) {
-            if (byte & (1 << (7 - col))) {
-                sdlgfx_pixel(x + col, y + row);
-            }
+            pixels[row * FONT_WIDTH + col] = (bitmap[row] & (0x80 >> col)) ? 0xFFFFFFFF : 0;
         }
     }
+    int slot = atlas_count++;
+    SDL_Rect cell = {(slot % ATLAS_COLS) * FONT_WIDTH, (slot / ATLAS_COLS) * FONT_HEIGHT, FONT_WIDTH, FONT_HEIGHT};
+    SDL_UpdateTexture(atlas_texture, &cell, pixels, FONT_WIDTH * (int)sizeof(uint32_t));
+    glyph_cells[index] = (uint16_t)(slot + 1);
+    return slot;
 }
 
-void sdlfont_draw_string(int x, int y, const char *str, SDL_Renderer *renderer) {
-    int current_x = x;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+static SDL_Vertex atlas_vertices[ATLAS_BATCH * 4];
+static int atlas_indices[ATLAS_BATCH * 6];
+#endif
+
+// Рисует строку через атлас; 0 — если атлас не подходит и нужен путь по глифам
+static int atlas_draw_string(int x, int y, const char *str, SDL_Renderer *renderer) {
+    Uint8 r, g, b, a;
+    SDL_BlendMode mode;
+    SDL_GetRenderDrawColor(renderer, &r, &g, &b, &a);
+    SDL_GetRenderDrawBlendMode(renderer, &mode);
+    if (mode == SDL_BLENDMODE_NONE) {
+        mode = SDL_BLENDMODE_BLEND; // Прозрачные тексели не должны затирать фон
+        a = 255;
+    } else if (mode == SDL_BLENDMODE_MOD) {
+        return 0; // MOD затемнил бы фон под прозрачными текселями
+    }
+    if (!glyph_data) glyph_table_build();
+    if (!glyph_data || !atlas_create(renderer)) return 0;
+    SDL_SetTextureBlendMode(atlas_texture, mode);
+
+    const float cw = 1.0f / ATLAS_COLS, ch = 1.0f / ATLAS_ROWS;
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (atlas_indices[5] == 0) {
+        for (int i = 0; i < ATLAS_BATCH; i++) {
+            static const int quad[6] = {0, 1, 2, 2, 1, 3};
+            for (int k = 0; k < 6; k++) atlas_indices[i * 6 + k] = i * 4 + quad[k];
+        }
+    }
+    SDL_Color color = {r, g, b, a};
+    int n = 0;
     while (*str) {
-        uint32_t codepoint = 0;
-        int bytes = 0;
-        if ((*str & 0x80) == 0) {
-            codepoint = *str;
-            bytes = 1;
-        } else if ((*str & 0xE0) == 0xC0) {
-            codepoint = (*str & 0x1F) << 6 | (str[1] & 0x3F);
-            bytes = 2;
-        } else {
-            codepoint = '?';
-            bytes = 1;
+        uint32_t index = glyph_index(utf8_next(&str, '?'));
+        int slot = atlas_lookup(index);
+        if (slot < 0) {
+            // Атлас полон: дорисовываем накопленное и начинаем его заново
+            if (n) SDL_RenderGeometry(renderer, atlas_texture, atlas_vertices, n * 4, atlas_indices, n * 6);
+            n = 0;
+            atlas_reset();
+            slot = atlas_lookup(index);
+        }
+        float u = (slot % ATLAS_COLS) * cw, v = (slot / ATLAS_COLS) * ch;
+        SDL_Vertex *q = &atlas_vertices[n * 4];
+        for (int k = 0; k < 4; k++) {
+            q[k].position.x = (float)(x + (k & 1) * FONT_WIDTH);
+            q[k].position.y = (float)(y + (k >> 1) * FONT_HEIGHT);
+            q[k].color = color;
+            q[k].tex_coord.x = u + (k & 1) * cw;
+            q[k].tex_coord.y = v + (k >> 1) * ch;
+        }
+        x += FONT_WIDTH;
+        if (++n == ATLAS_BATCH) {
+            SDL_RenderGeometry(renderer, atlas_texture, atlas_vertices, n * 4, atlas_indices, n * 6);
+            n = 0;
         }
+    }
+    if (n) SDL_RenderGeometry(renderer, atlas_texture, atlas_vertices, n * 4, atlas_indices, n * 6);
+#else
+    (void)cw; (void)ch;
+    SDL_SetTextureColorMod(atlas_texture, r, g, b);
+    SDL_SetTextureAlphaMod(atlas_texture, a);
+    while (*str) {
+        uint32_t index = glyph_index(utf8_next(&str, '?'));
+        int slot = atlas_lookup(index);
+        if (slot < 0) {
+            atlas_reset();
+            slot = atlas_lookup(index);
+        }
+        SDL_Rect cell = {(slot % ATLAS_COLS) * FONT_WIDTH, (slot / ATLAS_COLS) * FONT_HEIGHT, FONT_WIDTH, FONT_HEIGHT};
+        SDL_Rect dst = {x, y, FONT_WIDTH, FONT_HEIGHT};
+        SDL_RenderCopy(renderer, atlas_texture, &cell, &dst);
+        x += FONT_WIDTH;
+    }
+#endif
+    return 1;
+}
 
-        FontBitmap bitmap;
-        sdlfont_generate_char_bitmap(bitmap, codepoint);
-        sdlfont_draw_char(current_x, y, bitmap, renderer);
+void sdlfont_draw_string(int x, int y, const char *str, SDL_Renderer *renderer) {
+    // С рендерером строка идёт через атлас, без него (кадровый буфер) — по глифам
+    if (renderer && atlas_draw_string(x, y, str, renderer)) return;
+
+    int current_x = x;
+    while (*str) {
+        sdlfont_draw_char(current_x, y, sdlfont_glyph(utf8_next(&str, '?')), renderer);
         current_x += FONT_WIDTH;
-        str += bytes;
     }
 }
 
 void sdlfont_generate_char_bitmap(uint8_t *bitmap, uint32_t c) {
-    // Сначала проверяем PSF для c <= 255
-    if (c <= 255 && psf_font_data) {
-        uint8_t char_index = (uint8_t)c;
-        memcpy(bitmap, &psf_font_data[char_index * psf_font_height], psf_font_height);
-        return;
-    }
-
-    // Затем проверяем font_data для всех символов (включая c > 255)
-#ifdef USE_UNICODE
-    for (int i = 0; i < font_data_size; i++) {
-        if (font_data[i].codepoint == c) {
-            memcpy(bitmap, font_data[i].bitmap, FONT_HEIGHT);
-            return;
-        }
-    }
-#endif
+    memcpy(bitmap, sdlfont_glyph(c), FONT_HEIGHT);
+}
 
-    // Fallback на встроенный ASCII, только если нет USE_UNICODE или PSF
+// Встроенный ASCII, используется только при сборке таблицы глифов
+static void builtin_char_bitmap(uint8_t *bitmap, uint32_t c) {
     for (int row = 0; row < FONT_HEIGHT; row++) {
         bitmap[row] = 0x00;
     }
@@ -2,6 +2,7 @@
 
 import argparse
 import re
+import struct
 
 def parse_bdf(file_path):
     glyphs = {}
@@ -56,15 +57,40 @@ def generate_header(glyphs, output_file):
         f.write('static const int font_data_size = sizeof(font_data) / sizeof(font_data[0]);\n')
         f.write('#endif // SDLFONT_UNICODE_H\n')
 
+def generate_cache(glyphs, output_file):
+    # Формат читает sdlfont_load_cache: заголовок, диапазоны кодовых точек, глифы
+    codepoints = sorted(k for k in glyphs if 0 <= k <= 0x10FFFF)
+    ranges = []
+    for index, codepoint in enumerate(codepoints):
+        if ranges and ranges[-1][0] + ranges[-1][1] == codepoint:
+            ranges[-1][1] += 1
+        else:
+            ranges.append([codepoint, 1, index])
+
+    with open(output_file, 'wb') as f:
+        f.write(b'SFNC')
+        f.write(struct.pack('<5I', 1, 8, 16, len(ranges), len(codepoints)))
+        for first, count, index in ranges:
+            f.write(struct.pack('<3I', first, count, index))
+        for codepoint in codepoints:
+            f.write(bytes(glyphs[codepoint]))
+
 def main():
-    parser = argparse.ArgumentParser(description='Convert BDF font to sdlfont-compatible header.')
+    parser = argparse.ArgumentParser(description='Convert BDF font to sdlfont-compatible header or font cache.')
     parser.add_argument('-in', '--input', required=True, help='Input BDF file')
-    parser.add_argument('-out', '--output', required=True, help='Output header file')
+    parser.add_argument('-out', '--output', help='Output header file')
+    parser.add_argument('-cache', '--cache', help='Output binary font cache for sdlfont_load_cache()')
     args = parser.parse_args()
+    if not args.output and not args.cache:
+        parser.error('at least one of --output or --cache is required')
 
     glyphs = parse_bdf(args.input)
-    generate_header(glyphs, args.output)
-    print(f"Generated {args.output} with {len(glyphs)} glyphs (filtered to ASCII + Cyrillic).")
+    if args.output:
+        generate_header(glyphs, args.output)
+        print(f"Generated {args.output} with {len(glyphs)} glyphs (filtered to ASCII + Cyrillic).")
+    if args.cache:
+        generate_cache(glyphs, args.cache)
+        print(f"Generated {args.cache} with {len(glyphs)} glyphs.")
 
 if __name__ == '__main__':
     main()
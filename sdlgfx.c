@@ -49,7 +49,15 @@
 #include "sdlgfx.h"
 #include "sdlfont.h"
 #include <math.h>
-#include <emmintrin.h> // SSE2 intrinsics
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SDLGFX_X86 1
+#include <immintrin.h> // SSE2, SSE4.1 and AVX2 intrinsics, picked at run time
+#if defined(__GNUC__) || defined(__clang__)
+#define SIMD_TARGET(isa) __attribute__((target(isa))) //!< Compiles one function for a higher instruction set.
+#else
+#define SIMD_TARGET(isa) // MSVC compiles intrinsics of every level without flags
+#endif
+#endif
 
 #ifndef M_PI
     #define M_PI acos(-1.0)
@@ -62,12 +70,2825 @@
 SDL_Window *sdlgfx_window = NULL;     //!< SDL window handle.
 SDL_Renderer *sdlgfx_renderer = NULL;   //!< SDL renderer handle.
 SDL_Texture *sdlgfx_texture = NULL;    //!< SDL texture for rendering.
+static SDL_Surface *offscreen_surface = NULL; //!< Target of the software renderer when opened without a window.
+static SDL_Surface *window_surface = NULL;    //!< Surface of sdlgfx_window drawn into by the window surface backend.
 static int window_width = 0;          //!< Width of the graphics window.
 static int window_height = 0;         //!< Height of the graphics window.
 static int clear_r = 0;               //!< Red component of the clear color.
 static int clear_g = 0;               //!< Green component of the clear color.
 static int clear_b = 0;               //!< Blue component of the clear color.
 static SDL_Color current_color = {0, 0, 0, 255}; //!< Current drawing color.
+static Uint32 packed_color = 0x000000FF; //!< Current drawing color packed as RGBA8888.
+static int draw_blend = SDLGFX_BLEND_ALPHA; //!< Blend mode of all primitives.
+
+/* ====================================================================== */
+/*                  CLIP RECTANGLE SECTION                                */
+/* ====================================================================== */
+
+static SDL_Rect user_clip = {0, 0, 0, 0}; //!< Rectangle set by sdlgfx_set_clip().
+static int use_clip = 0;              //!< Flag: user_clip limits drawing.
+static int clip_left = 0;             //!< Left edge of the effective clip box (inclusive).
+static int clip_top = 0;              //!< Top edge of the effective clip box (inclusive).
+static int clip_right = 0;            //!< Right edge of the effective clip box (exclusive).
+static int clip_bottom = 0;           //!< Bottom edge of the effective clip box (exclusive).
+
+/**
+ * @brief Tells whether a pixel lies inside the clip box.
+ */
+static inline int clip_contains(int x, int y) {
+    return x >= clip_left && x < clip_right && y >= clip_top && y < clip_bottom;
+}
+
+/**
+ * @brief Tells whether the inclusive box x1..x2 x y1..y2 overlaps the clip box.
+ */
+static inline int clip_overlaps(int x1, int y1, int x2, int y2) {
+    return x1 <= x2 && y1 <= y2 && x2 >= clip_left && x1 < clip_right && y2 >= clip_top && y1 < clip_bottom;
+}
+
+/**
+ * @brief Cuts a rectangle given by its corner and size down to the clip box.
+ * @return 0 if nothing of it is left.
+ */
+static inline int clip_rectangle(int *x, int *y, int *w, int *h) {
+    int x1 = *x > clip_left ? *x : clip_left;
+    int y1 = *y > clip_top ? *y : clip_top;
+    int x2 = *x + *w < clip_right ? *x + *w : clip_right;
+    int y2 = *y + *h < clip_bottom ? *y + *h : clip_bottom;
+    if (x1 >= x2 || y1 >= y2) return 0;
+    *x = x1;
+    *y = y1;
+    *w = x2 - x1;
+    *h = y2 - y1;
+    return 1;
+}
+
+/**
+ * @brief The visible part of a Bresenham line, walked one pixel at a time.
+ */
+typedef struct {
+    int x, y;              //!< Current pixel.
+    int count;             //!< Number of visible pixels.
+    int step_x, step_y;    //!< Step along the major axis.
+    int minor_x, minor_y;  //!< Extra step when the minor axis advances.
+    Sint64 err;            //!< Minor axis remainder, carries when it reaches limit.
+    Sint64 inc, limit;     //!< 2 * minor and 2 * major.
+} LineWalk;
+
+/**
+ * @brief Range of steps d >= 0 from p in direction s that stay on [lo, hi).
+ */
+static inline void line_axis_range(Sint64 p, int s, int lo, int hi, Sint64 *d1, Sint64 *d2) {
+    *d1 = s > 0 ? lo - p : p - (hi - 1);
+    *d2 = s > 0 ? hi - 1 - p : p - lo;
+}
+
+/**
+ * @brief Finds the pixels of the line x1,y1 - x2,y2 (both ends included)
+ * that lie in [bx1, bx2) x [by1, by2).
+ *
+ * Pixel k of the Bresenham line lies k steps along the major axis and
+ * floor((2 * minor * k + major) / (2 * major)) steps along the minor axis.
+ * Both grow with k, so, as in Liang-Barsky, every edge of the box bounds k
+ * from one side and the visible pixels are one range of k, computed exactly.
+ * Walking that range gives the pixels of the whole line that pass the clip.
+ * @return 1 with w positioned on the first visible pixel, 0 if none is visible.
+ */
+static int line_clip(LineWalk *w, int x1, int y1, int x2, int y2, int bx1, int by1, int bx2, int by2) {
+    if (bx1 >= bx2 || by1 >= by2) return 0;
+    Sint64 dx = (Sint64)x2 - x1, dy = (Sint64)y2 - y1;
+    int sx = dx < 0 ? -1 : 1, sy = dy < 0 ? -1 : 1;
+    if (dx < 0) dx = -dx;
+    if (dy < 0) dy = -dy;
+    int x_major = dx >= dy;
+    Sint64 major = x_major ? dx : dy, minor = x_major ? dy : dx;
+
+    Sint64 k1, k2, m1, m2;
+    if (x_major) {
+        line_axis_range(x1, sx, bx1, bx2, &k1, &k2);
+        line_axis_range(y1, sy, by1, by2, &m1, &m2);
+    } else {
+        line_axis_range(y1, sy, by1, by2, &k1, &k2);
+        line_axis_range(x1, sx, bx1, bx2, &m1, &m2);
+    }
+    if (k1 < 0) k1 = 0;
+    if (k2 > major) k2 = major;
+    if (m1 < 0) m1 = 0;
+    if (m2 > minor) m2 = minor;
+    if (k1 > k2 || m1 > m2) return 0;
+
+    // First k reaching minor offset m1, and last k before reaching m2 + 1
+    if (m1 > 0) {
+        Sint64 k = (2 * major * m1 - major + 2 * minor - 1) / (2 * minor);
+        if (k > k1) k1 = k;
+    }
+    if (m2 < minor) {
+        Sint64 k = (2 * major * (m2 + 1) - major + 2 * minor - 1) / (2 * minor) - 1;
+        if (k < k2) k2 = k;
+    }
+    if (k1 > k2) return 0;
+
+    Sint64 limit = major ? 2 * major : 1;
+    Sint64 num = 2 * minor * k1 + major;
+    Sint64 m = num / limit;
+    w->step_x = x_major ? sx : 0;
+    w->step_y = x_major ? 0 : sy;
+    w->minor_x = x_major ? 0 : sx;
+    w->minor_y = x_major ? sy : 0;
+    w->x = (int)(x1 + (x_major ? k1 : m) * sx);
+    w->y = (int)(y1 + (x_major ? m : k1) * sy);
+    w->count = (int)(k2 - k1 + 1);
+    w->err = num % limit;
+    w->inc = 2 * minor;
+    w->limit = limit;
+    return 1;
+}
+
+/**
+ * @brief Moves a line walk to its next pixel.
+ */
+static inline void line_step(LineWalk *w) {
+    w->x += w->step_x;
+    w->y += w->step_y;
+    w->err += w->inc;
+    if (w->err >= w->limit) {
+        w->err -= w->limit;
+        w->x += w->minor_x;
+        w->y += w->minor_y;
+    }
+}
+
+/* ====================================================================== */
+/*                  PIXEL KERNELS SECTION                                 */
+/* ====================================================================== */
+
+/**
+ * @brief A blend mode resolved for one color.
+ *
+ * The framebuffer is opaque, so its pixels are their own premultiplied form,
+ * and every mode becomes min(255, dst * mul / 255 + add) per channel with the
+ * premultiplied source folded into mul and add:
+ * alpha: mul = 255 - a, add = src * a; additive: mul = 255, add = src * a;
+ * multiply: mul = src * a + 255 - a, add = 0. A mul of 0 means the color is
+ * simply written.
+ */
+typedef struct {
+    Uint32 mul;  //!< Destination factor per channel, RGBA8888 layout, alpha 0.
+    Uint32 add;  //!< Premultiplied source per channel, RGBA8888 layout, alpha 255.
+} BlendOp;
+
+/**
+ * @brief Packs a color into the RGBA8888 layout used by the framebuffer.
+ */
+static inline Uint32 fb_pack(int r, int g, int b, int a) {
+    return ((Uint32)(r & 0xFF) << 24) | ((Uint32)(g & 0xFF) << 16) | ((Uint32)(b & 0xFF) << 8) | (Uint32)(a & 0xFF);
+}
+
+/**
+ * @brief Returns v / 255 rounded to nearest, exact for 0 <= v <= 255 * 255.
+ */
+static inline int div255(int v) {
+    v += 128;
+    return (v + (v >> 8)) >> 8;
+}
+
+/**
+ * @brief Resolves a blend mode for an RGBA8888 color.
+ */
+static BlendOp blend_setup(Uint32 color, int mode) {
+    int a = color & 0xFF;
+    int r = div255((int)(color >> 24) * a);
+    int g = div255((int)((color >> 16) & 0xFF) * a);
+    int b = div255((int)((color >> 8) & 0xFF) * a);
+    BlendOp op;
+    if (mode == SDLGFX_BLEND_ALPHA && a < 255) {
+        op.mul = fb_pack(255 - a, 255 - a, 255 - a, 0);
+        op.add = fb_pack(r, g, b, 255);
+    } else if (mode == SDLGFX_BLEND_ADD) {
+        op.mul = fb_pack(255, 255, 255, 0);
+        op.add = fb_pack(r, g, b, 255);
+    } else if (mode == SDLGFX_BLEND_MUL) {
+        op.mul = fb_pack(r + 255 - a, g + 255 - a, b + 255 - a, 0);
+        op.add = 0xFF;
+    } else {
+        op.mul = 0;
+        op.add = color | 0xFF;
+    }
+    return op;
+}
+
+/**
+ * @brief Checks whether a color leaves every pixel unchanged in a blend mode.
+ */
+static inline int blend_is_noop(Uint32 color, int mode) {
+    return (color & 0xFF) == 0 && (mode == SDLGFX_BLEND_ALPHA || mode == SDLGFX_BLEND_ADD || mode == SDLGFX_BLEND_MUL);
+}
+
+/**
+ * @brief Blends one pixel, see BlendOp.
+ */
+static inline Uint32 blend_pixel(Uint32 dst, const BlendOp *op) {
+    Uint32 out = 0xFF;
+    for (int shift = 8; shift < 32; shift += 8) {
+        int c = div255((int)((dst >> shift) & 0xFF) * (int)((op->mul >> shift) & 0xFF)) + (int)((op->add >> shift) & 0xFF);
+        out |= (Uint32)(c > 255 ? 255 : c) << shift;
+    }
+    return out;
+}
+
+/*
+ * The hot loops below exist once per instruction set. sdlgfx_open() asks the
+ * CPU what it supports and fills the simd table with the best set, so one
+ * binary runs the AVX2 kernels where they are available and still starts on
+ * older x86 and non-x86 machines. All variants produce identical pixels.
+ */
+
+#define TRI_BLOCK 8 //!< Block size of the framebuffer triangle rasterizer.
+
+/**
+ * @brief The pixel kernels of one instruction set.
+ */
+typedef struct {
+    //! Writes count pixels of one color.
+    void (*fill)(Uint32 *dst, int count, Uint32 color);
+    //! Blends count pixels with one resolved color.
+    void (*blend)(Uint32 *dst, int count, const BlendOp *op);
+    //! Blends count opaque pixels from src with the same alpha in a blend mode.
+    void (*blend_colors)(Uint32 *dst, const Uint32 *src, int count, int alpha, int mode);
+    //! Fills the covered pixels of rows block rows of TRI_BLOCK pixels.
+    void (*tri_block)(Uint32 *row, int pitch, int rows, const int f[3], const int a[3], const int b[3],
+                      Uint32 color, const BlendOp *op);
+    //! Writes count Gouraud shaded pixels, channels in 16.16 fixed point.
+    void (*gradient)(Uint32 *dst, int count, int r, int g, int b, const int step[3]);
+    //! Draws the set bits of an 8 pixel glyph row, most significant bit first.
+    void (*glyph)(Uint32 *dst, int bits, Uint32 color, const BlendOp *op);
+} SimdKernels;
+
+/**
+ * @brief Writes count pixels of one color.
+ */
+static void fill_scalar(Uint32 *dst, int count, Uint32 color) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = color;
+    }
+}
+
+/**
+ * @brief Blends count pixels with one color, see BlendOp.
+ */
+static void blend_scalar(Uint32 *dst, int count, const BlendOp *op) {
+    for (int i = 0; i < count; i++) {
+        dst[i] = blend_pixel(dst[i], op);
+    }
+}
+
+/**
+ * @brief Blends count opaque source pixels with the same alpha onto dst.
+ *
+ * Used by shaded primitives, whose color changes from pixel to pixel.
+ */
+static void blend_colors_scalar(Uint32 *dst, const Uint32 *src, int count, int alpha, int mode) {
+    for (int i = 0; i < count; i++) {
+        BlendOp op = blend_setup((src[i] & 0xFFFFFF00) | (Uint32)alpha, mode);
+        dst[i] = op.mul ? blend_pixel(dst[i], &op) : op.add;
+    }
+}
+
+/**
+ * @brief Fills the covered pixels of rows block rows of TRI_BLOCK pixels.
+ * @param row First pixel of the first block row.
+ * @param pitch Row length in pixels.
+ * @param f Edge values at the first pixel.
+ * @param a Edge steps per pixel to the right.
+ * @param b Edge steps per row down.
+ * @param op Blending of the target, covered pixels get the blended color.
+ */
+static void tri_block_scalar(Uint32 *row, int pitch, int rows, const int f[3], const int a[3], const int b[3],
+                             Uint32 color, const BlendOp *op) {
+    int e[3] = {f[0], f[1], f[2]};
+    for (int j = 0; j < rows; j++, row += pitch) {
+        for (int i = 0; i < TRI_BLOCK; i++) {
+            if (((e[0] + i * a[0]) | (e[1] + i * a[1]) | (e[2] + i * a[2])) >= 0) {
+                row[i] = op->mul ? blend_pixel(row[i], op) : color;
+            }
+        }
+        e[0] += b[0];
+        e[1] += b[1];
+        e[2] += b[2];
+    }
+}
+
+/**
+ * @brief Writes count Gouraud shaded RGBA8888 pixels starting at dst.
+ *
+ * The channels are 16.16 fixed point, advanced by the x gradients.
+ */
+static void gradient_scalar(Uint32 *dst, int count, int r, int g, int b, const int step[3]) {
+    for (int i = 0; i < count; i++) {
+        int cr = r >> 16, cg = g >> 16, cb = b >> 16;
+        cr = cr < 0 ? 0 : (cr > 255 ? 255 : cr);
+        cg = cg < 0 ? 0 : (cg > 255 ? 255 : cg);
+        cb = cb < 0 ? 0 : (cb > 255 ? 255 : cb);
+        dst[i] = ((Uint32)cr << 24) | ((Uint32)cg << 16) | ((Uint32)cb << 8) | 0xFF;
+        r += step[0];
+        g += step[1];
+        b += step[2];
+    }
+}
+
+/**
+ * @brief Draws the set bits of an 8 pixel glyph row, most significant bit first.
+ */
+static void glyph_scalar(Uint32 *dst, int bits, Uint32 color, const BlendOp *op) {
+    for (int i = 0; i < 8; i++) {
+        if (bits & (0x80 >> i)) dst[i] = op->mul ? blend_pixel(dst[i], op) : color;
+    }
+}
+
+#ifdef SDLGFX_X86
+
+/**
+ * @brief Returns div255(x * y) for 16-bit lanes, bias is 128 in every lane.
+ */
+SIMD_TARGET("sse2") static inline __m128i mul255_sse2(__m128i x, __m128i y, __m128i bias) {
+    __m128i v = _mm_add_epi16(_mm_mullo_epi16(x, y), bias);
+    return _mm_srli_epi16(_mm_add_epi16(v, _mm_srli_epi16(v, 8)), 8);
+}
+
+/**
+ * @brief Blends 4 pixels. mul holds the factors of one pixel as 16-bit lanes
+ * in each half, bias is 128 in every 16-bit lane.
+ */
+SIMD_TARGET("sse2") static inline __m128i blend_vec_sse2(__m128i d, __m128i mul, __m128i add, __m128i bias) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = mul255_sse2(_mm_unpacklo_epi8(d, zero), mul, bias);
+    __m128i hi = mul255_sse2(_mm_unpackhi_epi8(d, zero), mul, bias);
+    return _mm_adds_epu8(_mm_packus_epi16(lo, hi), add);
+}
+
+/**
+ * @brief Writes count pixels of one color, 4 per store.
+ */
+SIMD_TARGET("sse2") static void fill_sse2(Uint32 *dst, int count, Uint32 color) {
+    const __m128i col = _mm_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        _mm_storeu_si128((__m128i *)(dst + i), col);
+    }
+    fill_scalar(dst + i, count - i, color);
+}
+
+/**
+ * @brief Blends count pixels with one color, 4 per step.
+ */
+SIMD_TARGET("sse2") static void blend_sse2(Uint32 *dst, int count, const BlendOp *op) {
+    const __m128i mul = _mm_unpacklo_epi8(_mm_set1_epi32((int)op->mul), _mm_setzero_si128());
+    const __m128i add = _mm_set1_epi32((int)op->add);
+    const __m128i bias = _mm_set1_epi16(128);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), blend_vec_sse2(d, mul, add, bias));
+    }
+    blend_scalar(dst + i, count - i, op);
+}
+
+/**
+ * @brief Blends count opaque source pixels with the same alpha onto dst, 4 per step.
+ *
+ * The source is premultiplied in the registers and combined as in BlendOp.
+ */
+SIMD_TARGET("sse2") static void blend_colors_sse2(Uint32 *dst, const Uint32 *src, int count, int alpha, int mode) {
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i bias = _mm_set1_epi16(128);
+    const __m128i va = _mm_set1_epi16((short)alpha);
+    const __m128i vinv = _mm_set1_epi16((short)(mode == SDLGFX_BLEND_ADD ? 255 : 255 - alpha));
+    const __m128i opaque = _mm_set1_epi32(0xFF);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        __m128i slo = mul255_sse2(_mm_unpacklo_epi8(s, zero), va, bias); // Premultiplied source
+        __m128i shi = mul255_sse2(_mm_unpackhi_epi8(s, zero), va, bias);
+        __m128i res;
+        if (mode == SDLGFX_BLEND_MUL) {
+            __m128i dlo = mul255_sse2(_mm_unpacklo_epi8(d, zero), _mm_add_epi16(slo, vinv), bias);
+            __m128i dhi = mul255_sse2(_mm_unpackhi_epi8(d, zero), _mm_add_epi16(shi, vinv), bias);
+            res = _mm_packus_epi16(dlo, dhi);
+        } else {
+            res = _mm_adds_epu8(blend_vec_sse2(d, vinv, zero, bias), _mm_packus_epi16(slo, shi));
+        }
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_or_si128(res, opaque));
+    }
+    blend_colors_scalar(dst + i, src + i, count - i, alpha, mode);
+}
+
+/**
+ * @brief Triangle block rows with SSE2, see tri_block_scalar().
+ */
+SIMD_TARGET("sse2") static void tri_block_sse2(Uint32 *row, int pitch, int rows, const int f[3], const int a[3],
+                                               const int b[3], Uint32 color, const BlendOp *op) {
+    const __m128i mul = _mm_unpacklo_epi8(_mm_set1_epi32((int)op->mul), _mm_setzero_si128());
+    const __m128i add = _mm_set1_epi32((int)op->add);
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i col = _mm_set1_epi32((int)color);
+    int e[3] = {f[0], f[1], f[2]};
+    for (int j = 0; j < rows; j++, row += pitch) {
+        for (int half = 0; half < TRI_BLOCK; half += 4) {
+            // SSE2 has no 32-bit multiply, so the lane offsets are built from scalars
+            __m128i e0 = _mm_setr_epi32(e[0] + half * a[0], e[0] + (half + 1) * a[0], e[0] + (half + 2) * a[0], e[0] + (half + 3) * a[0]);
+            __m128i e1 = _mm_setr_epi32(e[1] + half * a[1], e[1] + (half + 1) * a[1], e[1] + (half + 2) * a[1], e[1] + (half + 3) * a[1]);
+            __m128i e2 = _mm_setr_epi32(e[2] + half * a[2], e[2] + (half + 1) * a[2], e[2] + (half + 2) * a[2], e[2] + (half + 3) * a[2]);
+            // The sign bit of the OR is set when any edge is negative
+            __m128i outside = _mm_srai_epi32(_mm_or_si128(_mm_or_si128(e0, e1), e2), 31);
+            __m128i old = _mm_loadu_si128((const __m128i *)(row + half));
+            if (op->mul) col = blend_vec_sse2(old, mul, add, bias);
+            __m128i res = _mm_or_si128(_mm_and_si128(outside, old), _mm_andnot_si128(outside, col));
+            _mm_storeu_si128((__m128i *)(row + half), res);
+        }
+        e[0] += b[0];
+        e[1] += b[1];
+        e[2] += b[2];
+    }
+}
+
+/**
+ * @brief Gouraud span with SSE2, 4 pixels packed per step, see gradient_scalar().
+ */
+SIMD_TARGET("sse2") static void gradient_sse2(Uint32 *dst, int count, int r, int g, int b, const int step[3]) {
+    const __m128i max = _mm_set1_epi32(255);
+    const __m128i alpha = _mm_set1_epi32(0xFF);
+    __m128i vr = _mm_setr_epi32(r, r + step[0], r + 2 * step[0], r + 3 * step[0]);
+    __m128i vg = _mm_setr_epi32(g, g + step[1], g + 2 * step[1], g + 3 * step[1]);
+    __m128i vb = _mm_setr_epi32(b, b + step[2], b + 2 * step[2], b + 3 * step[2]);
+    const __m128i sr = _mm_set1_epi32(step[0] * 4);
+    const __m128i sg = _mm_set1_epi32(step[1] * 4);
+    const __m128i sb = _mm_set1_epi32(step[2] * 4);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i c[3] = {_mm_srai_epi32(vr, 16), _mm_srai_epi32(vg, 16), _mm_srai_epi32(vb, 16)};
+        for (int ch = 0; ch < 3; ch++) {
+            // SSE2 has no 32-bit min/max: clear negatives, then saturate above 255
+            c[ch] = _mm_andnot_si128(_mm_srai_epi32(c[ch], 31), c[ch]);
+            __m128i over = _mm_cmpgt_epi32(c[ch], max);
+            c[ch] = _mm_or_si128(_mm_andnot_si128(over, c[ch]), _mm_and_si128(over, max));
+        }
+        __m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(c[0], 24), _mm_slli_epi32(c[1], 16)),
+                                  _mm_or_si128(_mm_slli_epi32(c[2], 8), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i), px);
+        vr = _mm_add_epi32(vr, sr);
+        vg = _mm_add_epi32(vg, sg);
+        vb = _mm_add_epi32(vb, sb);
+    }
+    gradient_scalar(dst + i, count - i, r + i * step[0], g + i * step[1], b + i * step[2], step);
+}
+
+/**
+ * @brief Glyph row with SSE2: each pixel tests its bit in a broadcast of the row.
+ */
+SIMD_TARGET("sse2") static void glyph_sse2(Uint32 *dst, int bits, Uint32 color, const BlendOp *op) {
+    const __m128i bit_lo = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+    const __m128i bit_hi = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+    const __m128i v = _mm_set1_epi32(bits);
+    __m128i m_lo = _mm_cmpeq_epi32(_mm_and_si128(v, bit_lo), bit_lo);
+    __m128i m_hi = _mm_cmpeq_epi32(_mm_and_si128(v, bit_hi), bit_hi);
+    __m128i old_lo = _mm_loadu_si128((const __m128i *)dst);
+    __m128i old_hi = _mm_loadu_si128((const __m128i *)(dst + 4));
+    __m128i col_lo = _mm_set1_epi32((int)color), col_hi = col_lo;
+    if (op->mul) {
+        const __m128i mul = _mm_unpacklo_epi8(_mm_set1_epi32((int)op->mul), _mm_setzero_si128());
+        const __m128i add = _mm_set1_epi32((int)op->add);
+        const __m128i bias = _mm_set1_epi16(128);
+        col_lo = blend_vec_sse2(old_lo, mul, add, bias);
+        col_hi = blend_vec_sse2(old_hi, mul, add, bias);
+    }
+    _mm_storeu_si128((__m128i *)dst, _mm_or_si128(_mm_and_si128(m_lo, col_lo), _mm_andnot_si128(m_lo, old_lo)));
+    _mm_storeu_si128((__m128i *)(dst + 4), _mm_or_si128(_mm_and_si128(m_hi, col_hi), _mm_andnot_si128(m_hi, old_hi)));
+}
+
+/**
+ * @brief Triangle block rows with SSE4.1: edge values are stepped in the
+ * registers and covered pixels picked with blendv, see tri_block_scalar().
+ */
+SIMD_TARGET("sse4.1") static void tri_block_sse41(Uint32 *row, int pitch, int rows, const int f[3], const int a[3],
+                                                  const int b[3], Uint32 color, const BlendOp *op) {
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i mul = _mm_unpacklo_epi8(_mm_set1_epi32((int)op->mul), _mm_setzero_si128());
+    const __m128i add = _mm_set1_epi32((int)op->add);
+    const __m128i bias = _mm_set1_epi16(128);
+    __m128i col = _mm_set1_epi32((int)color);
+    __m128i e[3][2], step[3];
+    for (int k = 0; k < 3; k++) {
+        e[k][0] = _mm_add_epi32(_mm_set1_epi32(f[k]), _mm_mullo_epi32(lane, _mm_set1_epi32(a[k])));
+        e[k][1] = _mm_add_epi32(e[k][0], _mm_set1_epi32(4 * a[k]));
+        step[k] = _mm_set1_epi32(b[k]);
+    }
+    for (int j = 0; j < rows; j++, row += pitch) {
+        for (int h = 0; h < 2; h++) {
+            __m128i outside = _mm_srai_epi32(_mm_or_si128(_mm_or_si128(e[0][h], e[1][h]), e[2][h]), 31);
+            __m128i old = _mm_loadu_si128((const __m128i *)(row + 4 * h));
+            if (op->mul) col = blend_vec_sse2(old, mul, add, bias);
+            _mm_storeu_si128((__m128i *)(row + 4 * h), _mm_blendv_epi8(col, old, outside));
+            for (int k = 0; k < 3; k++) e[k][h] = _mm_add_epi32(e[k][h], step[k]);
+        }
+    }
+}
+
+/**
+ * @brief Gouraud span with SSE4.1, which has 32-bit multiply, min and max.
+ */
+SIMD_TARGET("sse4.1") static void gradient_sse41(Uint32 *dst, int count, int r, int g, int b, const int step[3]) {
+    const __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i max = _mm_set1_epi32(255);
+    const __m128i alpha = _mm_set1_epi32(0xFF);
+    __m128i vr = _mm_add_epi32(_mm_set1_epi32(r), _mm_mullo_epi32(lane, _mm_set1_epi32(step[0])));
+    __m128i vg = _mm_add_epi32(_mm_set1_epi32(g), _mm_mullo_epi32(lane, _mm_set1_epi32(step[1])));
+    __m128i vb = _mm_add_epi32(_mm_set1_epi32(b), _mm_mullo_epi32(lane, _mm_set1_epi32(step[2])));
+    const __m128i sr = _mm_set1_epi32(step[0] * 4);
+    const __m128i sg = _mm_set1_epi32(step[1] * 4);
+    const __m128i sb = _mm_set1_epi32(step[2] * 4);
+    int i = 0;
+    for (; i + 4 <= count; i += 4) {
+        __m128i cr = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(vr, 16), zero), max);
+        __m128i cg = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(vg, 16), zero), max);
+        __m128i cb = _mm_min_epi32(_mm_max_epi32(_mm_srai_epi32(vb, 16), zero), max);
+        __m128i px = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(cr, 24), _mm_slli_epi32(cg, 16)),
+                                  _mm_or_si128(_mm_slli_epi32(cb, 8), alpha));
+        _mm_storeu_si128((__m128i *)(dst + i), px);
+        vr = _mm_add_epi32(vr, sr);
+        vg = _mm_add_epi32(vg, sg);
+        vb = _mm_add_epi32(vb, sb);
+    }
+    gradient_scalar(dst + i, count - i, r + i * step[0], g + i * step[1], b + i * step[2], step);
+}
+
+/**
+ * @brief Returns div255(x * y) for 16-bit lanes, bias is 128 in every lane.
+ */
+SIMD_TARGET("avx2") static inline __m256i mul255_avx2(__m256i x, __m256i y, __m256i bias) {
+    __m256i v = _mm256_add_epi16(_mm256_mullo_epi16(x, y), bias);
+    return _mm256_srli_epi16(_mm256_add_epi16(v, _mm256_srli_epi16(v, 8)), 8);
+}
+
+/**
+ * @brief Blends 8 pixels, see blend_vec_sse2().
+ */
+SIMD_TARGET("avx2") static inline __m256i blend_vec_avx2(__m256i d, __m256i mul, __m256i add, __m256i bias) {
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo = mul255_avx2(_mm256_unpacklo_epi8(d, zero), mul, bias);
+    __m256i hi = mul255_avx2(_mm256_unpackhi_epi8(d, zero), mul, bias);
+    return _mm256_adds_epu8(_mm256_packus_epi16(lo, hi), add);
+}
+
+/**
+ * @brief Writes count pixels of one color, 8 per store.
+ */
+SIMD_TARGET("avx2") static void fill_avx2(Uint32 *dst, int count, Uint32 color) {
+    const __m256i col = _mm256_set1_epi32((int)color);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        _mm256_storeu_si256((__m256i *)(dst + i), col);
+    }
+    fill_scalar(dst + i, count - i, color);
+}
+
+/**
+ * @brief Blends count pixels with one color, 8 per step.
+ */
+SIMD_TARGET("avx2") static void blend_avx2(Uint32 *dst, int count, const BlendOp *op) {
+    const __m256i mul = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)op->mul), _mm256_setzero_si256());
+    const __m256i add = _mm256_set1_epi32((int)op->add);
+    const __m256i bias = _mm256_set1_epi16(128);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        _mm256_storeu_si256((__m256i *)(dst + i), blend_vec_avx2(d, mul, add, bias));
+    }
+    blend_scalar(dst + i, count - i, op);
+}
+
+/**
+ * @brief Blends count opaque source pixels with the same alpha onto dst, 8 per step.
+ */
+SIMD_TARGET("avx2") static void blend_colors_avx2(Uint32 *dst, const Uint32 *src, int count, int alpha, int mode) {
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i bias = _mm256_set1_epi16(128);
+    const __m256i va = _mm256_set1_epi16((short)alpha);
+    const __m256i vinv = _mm256_set1_epi16((short)(mode == SDLGFX_BLEND_ADD ? 255 : 255 - alpha));
+    const __m256i opaque = _mm256_set1_epi32(0xFF);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i s = _mm256_loadu_si256((const __m256i *)(src + i));
+        __m256i d = _mm256_loadu_si256((const __m256i *)(dst + i));
+        __m256i slo = mul255_avx2(_mm256_unpacklo_epi8(s, zero), va, bias); // Premultiplied source
+        __m256i shi = mul255_avx2(_mm256_unpackhi_epi8(s, zero), va, bias);
+        __m256i res;
+        if (mode == SDLGFX_BLEND_MUL) {
+            __m256i dlo = mul255_avx2(_mm256_unpacklo_epi8(d, zero), _mm256_add_epi16(slo, vinv), bias);
+            __m256i dhi = mul255_avx2(_mm256_unpackhi_epi8(d, zero), _mm256_add_epi16(shi, vinv), bias);
+            res = _mm256_packus_epi16(dlo, dhi);
+        } else {
+            res = _mm256_adds_epu8(blend_vec_avx2(d, vinv, zero, bias), _mm256_packus_epi16(slo, shi));
+        }
+        _mm256_storeu_si256((__m256i *)(dst + i), _mm256_or_si256(res, opaque));
+    }
+    blend_colors_scalar(dst + i, src + i, count - i, alpha, mode);
+}
+
+/**
+ * @brief Triangle block rows with AVX2, one register per block row, see tri_block_scalar().
+ */
+SIMD_TARGET("avx2") static void tri_block_avx2(Uint32 *row, int pitch, int rows, const int f[3], const int a[3],
+                                               const int b[3], Uint32 color, const BlendOp *op) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i mul = _mm256_unpacklo_epi8(_mm256_set1_epi32((int)op->mul), _mm256_setzero_si256());
+    const __m256i add = _mm256_set1_epi32((int)op->add);
+    const __m256i bias = _mm256_set1_epi16(128);
+    __m256i col = _mm256_set1_epi32((int)color);
+    __m256i e0 = _mm256_add_epi32(_mm256_set1_epi32(f[0]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[0])));
+    __m256i e1 = _mm256_add_epi32(_mm256_set1_epi32(f[1]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[1])));
+    __m256i e2 = _mm256_add_epi32(_mm256_set1_epi32(f[2]), _mm256_mullo_epi32(lane, _mm256_set1_epi32(a[2])));
+    const __m256i b0 = _mm256_set1_epi32(b[0]), b1 = _mm256_set1_epi32(b[1]), b2 = _mm256_set1_epi32(b[2]);
+    for (int j = 0; j < rows; j++, row += pitch) {
+        // The sign bit of the OR is set when any edge is negative
+        __m256i outside = _mm256_srai_epi32(_mm256_or_si256(_mm256_or_si256(e0, e1), e2), 31);
+        __m256i old = _mm256_loadu_si256((const __m256i *)row);
+        if (op->mul) col = blend_vec_avx2(old, mul, add, bias);
+        _mm256_storeu_si256((__m256i *)row, _mm256_blendv_epi8(col, old, outside));
+        e0 = _mm256_add_epi32(e0, b0);
+        e1 = _mm256_add_epi32(e1, b1);
+        e2 = _mm256_add_epi32(e2, b2);
+    }
+}
+
+/**
+ * @brief Gouraud span with AVX2, 8 pixels packed per step, see gradient_scalar().
+ */
+SIMD_TARGET("avx2") static void gradient_avx2(Uint32 *dst, int count, int r, int g, int b, const int step[3]) {
+    const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i max = _mm256_set1_epi32(255);
+    const __m256i alpha = _mm256_set1_epi32(0xFF);
+    __m256i vr = _mm256_add_epi32(_mm256_set1_epi32(r), _mm256_mullo_epi32(lane, _mm256_set1_epi32(step[0])));
+    __m256i vg = _mm256_add_epi32(_mm256_set1_epi32(g), _mm256_mullo_epi32(lane, _mm256_set1_epi32(step[1])));
+    __m256i vb = _mm256_add_epi32(_mm256_set1_epi32(b), _mm256_mullo_epi32(lane, _mm256_set1_epi32(step[2])));
+    const __m256i sr = _mm256_set1_epi32(step[0] * 8);
+    const __m256i sg = _mm256_set1_epi32(step[1] * 8);
+    const __m256i sb = _mm256_set1_epi32(step[2] * 8);
+    int i = 0;
+    for (; i + 8 <= count; i += 8) {
+        __m256i cr = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(vr, 16), zero), max);
+        __m256i cg = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(vg, 16), zero), max);
+        __m256i cb = _mm256_min_epi32(_mm256_max_epi32(_mm256_srai_epi32(vb, 16), zero), max);
+        __m256i px = _mm256_or_si256(_mm256_or_si256(_mm256_slli_epi32(cr, 24), _mm256_slli_epi32(cg, 16)),
+                                     _mm256_or_si256(_mm256_slli_epi32(cb, 8), alpha));
+        _mm256_storeu_si256((__m256i *)(dst + i), px);
+        vr = _mm256_add_epi32(vr, sr);
+        vg = _mm256_add_epi32(vg, sg);
+        vb = _mm256_add_epi32(vb, sb);
+    }
+    gradient_scalar(dst + i, count - i, r + i * step[0], g + i * step[1], b + i * step[2], step);
+}
+
+/**
+ * @brief Glyph row with AVX2, the whole row in one register, see glyph_sse2().
+ */
+SIMD_TARGET("avx2") static void glyph_avx2(Uint32 *dst, int bits, Uint32 color, const BlendOp *op) {
+    const __m256i bit = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+    __m256i set = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits), bit), bit);
+    __m256i old = _mm256_loadu_si256((const __m256i *)dst);
+    __m256i col = _mm256_set1_epi32((int)color);
+    if (op->mul) {
+        col = blend_vec_avx2(old, _mm256_unpacklo_epi8(_mm256_set1_epi32((int)op->mul), _mm256_setzero_si256()),
+                             _mm256_set1_epi32((int)op->add), _mm256_set1_epi16(128));
+    }
+    _mm256_storeu_si256((__m256i *)dst, _mm256_blendv_epi8(old, col, set));
+}
+
+#endif /* SDLGFX_X86 */
+
+static const char *const simd_names[] = {"scalar", "sse2", "sse4.1", "avx2"}; //!< Names of the SDLGFX_SIMD_* levels.
+static int simd_level = SDLGFX_SIMD_SCALAR; //!< Level of the kernels in simd.
+static int simd_limit = SDLGFX_SIMD_AVX2;   //!< Highest level simd_select() may pick.
+
+//! The active kernels, scalar until sdlgfx_open() picks the best for this CPU.
+static SimdKernels simd = {fill_scalar, blend_scalar, blend_colors_scalar, tri_block_scalar, gradient_scalar, glyph_scalar};
+
+/**
+ * @brief Picks the kernels of the highest instruction set the CPU and the OS
+ * support, capped by sdlgfx_set_simd().
+ */
+static void simd_select(void) {
+    static const SimdKernels kernels[] = {
+        {fill_scalar, blend_scalar, blend_colors_scalar, tri_block_scalar, gradient_scalar, glyph_scalar},
+#ifdef SDLGFX_X86
+        {fill_sse2, blend_sse2, blend_colors_sse2, tri_block_sse2, gradient_sse2, glyph_sse2},
+        {fill_sse2, blend_sse2, blend_colors_sse2, tri_block_sse41, gradient_sse41, glyph_sse2},
+        {fill_avx2, blend_avx2, blend_colors_avx2, tri_block_avx2, gradient_avx2, glyph_avx2}
+#endif
+    };
+    int level = SDLGFX_SIMD_SCALAR;
+#ifdef SDLGFX_X86
+    // SDL reads cpuid once, and only reports AVX2 when the OS saves the YMM registers
+    if (SDL_HasSSE2()) level = SDLGFX_SIMD_SSE2;
+    if (level == SDLGFX_SIMD_SSE2 && SDL_HasSSE41()) level = SDLGFX_SIMD_SSE41;
+#if SDL_VERSION_ATLEAST(2, 0, 4)
+    if (level == SDLGFX_SIMD_SSE41 && SDL_HasAVX2()) level = SDLGFX_SIMD_AVX2;
+#endif
+#endif
+    if (level > simd_limit) level = simd_limit;
+    simd_level = level;
+    simd = kernels[level];
+}
+
+/* ====================================================================== */
+/*                  CPU FRAMEBUFFER SECTION                               */
+/* ====================================================================== */
+
+/**
+ * @brief Drawing target for the CPU rasterizers.
+ *
+ * Pixels are RGBA8888, the same layout as sdlgfx_texture, so a frame can be
+ * uploaded with a single SDL_UpdateTexture. Writes are limited to the
+ * half-open clip box [clip_x1, clip_x2) x [clip_y1, clip_y2) and combined
+ * with the existing pixels by blend.
+ */
+typedef struct {
+    Uint32 *pixels;  //!< First pixel of the target.
+    int pitch;       //!< Row length in pixels.
+    int clip_x1;     //!< Left clip edge (inclusive).
+    int clip_y1;     //!< Top clip edge (inclusive).
+    int clip_x2;     //!< Right clip edge (exclusive).
+    int clip_y2;     //!< Bottom clip edge (exclusive).
+    BlendOp blend;   //!< How the color of the current command is applied.
+} FbTarget;
+
+static int use_framebuffer = 0;        //!< Flag to draw into the CPU framebuffer.
+static FbTarget fb = {NULL, 0, 0, 0, 0, 0, {0, 0}}; //!< The CPU framebuffer (SIMD aligned).
+
+/**
+ * @brief Writes or blends the color of the current command into one pixel.
+ */
+static inline void fb_put(const FbTarget *t, Uint32 *p, Uint32 color) {
+    *p = t->blend.mul ? blend_pixel(*p, &t->blend) : color;
+}
+
+/**
+ * @brief Writes a single pixel, ignoring pixels outside the clip box.
+ */
+static inline void fb_plot(const FbTarget *t, int x, int y, Uint32 color) {
+    if (x < t->clip_x1 || x >= t->clip_x2 || y < t->clip_y1 || y >= t->clip_y2) return;
+    fb_put(t, &t->pixels[y * t->pitch + x], color);
+}
+
+/**
+ * @brief Fills the horizontal span x1..x2 (inclusive, any order) on row y.
+ */
+static void fb_hline(const FbTarget *t, int x1, int x2, int y, Uint32 color) {
+    if (y < t->clip_y1 || y >= t->clip_y2) return;
+    if (x1 > x2) { int tmp = x1; x1 = x2; x2 = tmp; }
+    if (x1 < t->clip_x1) x1 = t->clip_x1;
+    if (x2 >= t->clip_x2) x2 = t->clip_x2 - 1;
+    if (x1 > x2) return;
+    Uint32 *row = t->pixels + y * t->pitch + x1;
+    if (t->blend.mul) {
+        simd.blend(row, x2 - x1 + 1, &t->blend);
+    } else {
+        simd.fill(row, x2 - x1 + 1, color);
+    }
+}
+
+/**
+ * @brief Fills a rectangle given by its top-left corner and size.
+ */
+static void fb_fill_rect(const FbTarget *t, int x, int y, int w, int h, Uint32 color) {
+    if (w <= 0 || h <= 0) return;
+    int y1 = y < t->clip_y1 ? t->clip_y1 : y;
+    int y2 = y + h > t->clip_y2 ? t->clip_y2 : y + h;
+    for (int row = y1; row < y2; row++) {
+        fb_hline(t, x, x + w - 1, row, color);
+    }
+}
+
+/**
+ * @brief Draws a line with both end points included (Bresenham), walking
+ * only the pixels inside the clip box.
+ */
+static void fb_line(const FbTarget *t, int x1, int y1, int x2, int y2, Uint32 color) {
+    if (y1 == y2) {
+        fb_hline(t, x1, x2, y1, color);
+        return;
+    }
+
+    LineWalk w;
+    if (!line_clip(&w, x1, y1, x2, y2, t->clip_x1, t->clip_y1, t->clip_x2, t->clip_y2)) return;
+    for (int i = 0; i < w.count; i++) {
+        fb_put(t, &t->pixels[w.y * t->pitch + w.x], color);
+        line_step(&w);
+    }
+}
+
+#define DIRTY_MAX 16 //!< Most changed regions tracked per frame, more are merged.
+
+/**
+ * @brief A changed region of the framebuffer, half-open like the clip box.
+ */
+typedef struct {
+    int x1, y1, x2, y2;
+} DirtyRect;
+
+static DirtyRect dirty_rects[DIRTY_MAX + 1]; //!< Regions changed since the last upload.
+static int dirty_count = 0;                  //!< Number of regions in dirty_rects.
+
+/**
+ * @brief Checks whether two regions overlap or share an edge.
+ */
+static inline int dirty_touch(const DirtyRect *a, const DirtyRect *b) {
+    return a->x1 <= b->x2 && b->x1 <= a->x2 && a->y1 <= b->y2 && b->y1 <= a->y2;
+}
+
+/**
+ * @brief Grows a to the bounding box of a and b.
+ */
+static inline void dirty_union(DirtyRect *a, const DirtyRect *b) {
+    if (b->x1 < a->x1) a->x1 = b->x1;
+    if (b->y1 < a->y1) a->y1 = b->y1;
+    if (b->x2 > a->x2) a->x2 = b->x2;
+    if (b->y2 > a->y2) a->y2 = b->y2;
+}
+
+/**
+ * @brief Returns the area of a region.
+ */
+static inline Sint64 dirty_area(const DirtyRect *r) {
+    return (Sint64)(r->x2 - r->x1) * (r->y2 - r->y1);
+}
+
+/**
+ * @brief Removes region j by moving the last region into its place.
+ */
+static void dirty_remove(int j) {
+    dirty_rects[j] = dirty_rects[--dirty_count];
+}
+
+/**
+ * @brief Merges every region that overlaps or touches region i into it,
+ * until it touches none of the others.
+ */
+static void dirty_absorb(int i) {
+    int j = 0;
+    while (j < dirty_count) {
+        if (j == i || !dirty_touch(&dirty_rects[i], &dirty_rects[j])) {
+            j++;
+            continue;
+        }
+        dirty_union(&dirty_rects[i], &dirty_rects[j]);
+        dirty_remove(j);
+        if (i == dirty_count) i = j; // Region i was the last one and moved to j
+        j = 0;                       // The grown region may touch earlier ones
+    }
+}
+
+/**
+ * @brief Marks [x1, x2) x [y1, y2) as changed.
+ *
+ * Regions that overlap or touch are merged. When there are more than
+ * DIRTY_MAX, the pair whose bounding box wastes the least area is merged, so
+ * a few scattered changes stay a few small uploads.
+ */
+static void dirty_add(int x1, int y1, int x2, int y2) {
+    DirtyRect r = {x1, y1, x2, y2};
+    for (int i = 0; i < dirty_count; i++) {
+        const DirtyRect *d = &dirty_rects[i];
+        if (x1 >= d->x1 && y1 >= d->y1 && x2 <= d->x2 && y2 <= d->y2) return;
+    }
+    for (int i = 0; i < dirty_count; i++) {
+        if (dirty_touch(&dirty_rects[i], &r)) {
+            dirty_union(&dirty_rects[i], &r);
+            dirty_absorb(i);
+            return;
+        }
+    }
+
+    dirty_rects[dirty_count++] = r;
+    if (dirty_count <= DIRTY_MAX) return;
+
+    int best_i = 0, best_j = 1;
+    Sint64 best_cost = -1;
+    for (int i = 0; i < dirty_count; i++) {
+        for (int j = i + 1; j < dirty_count; j++) {
+            DirtyRect u = dirty_rects[i];
+            dirty_union(&u, &dirty_rects[j]);
+            Sint64 cost = dirty_area(&u) - dirty_area(&dirty_rects[i]) - dirty_area(&dirty_rects[j]);
+            if (best_cost < 0 || cost < best_cost) {
+                best_cost = cost;
+                best_i = i;
+                best_j = j;
+            }
+        }
+    }
+    dirty_union(&dirty_rects[best_i], &dirty_rects[best_j]);
+    dirty_remove(best_j); // best_i < best_j, so region best_i stays in place
+    dirty_absorb(best_i);
+}
+
+/**
+ * @brief Marks the whole window as changed.
+ */
+static void dirty_all(void) {
+    dirty_rects[0].x1 = 0;
+    dirty_rects[0].y1 = 0;
+    dirty_rects[0].x2 = window_width;
+    dirty_rects[0].y2 = window_height;
+    dirty_count = 1;
+}
+
+/**
+ * @brief Allocates the CPU framebuffer for the current window size.
+ * @return 1 on success, 0 on allocation failure.
+ */
+static int fb_create(void) {
+    int pitch = (window_width + 15) & ~15; // Keep every row 64-byte aligned
+    Uint32 *pixels = (Uint32 *)SDL_SIMDAlloc((size_t)pitch * window_height * sizeof(Uint32));
+    if (!pixels) {
+        fprintf(stderr, "sdlgfx: Failed to allocate %dx%d framebuffer.\n", window_width, window_height);
+        return 0;
+    }
+    fb.pixels = pixels;
+    fb.pitch = pitch;
+    fb.clip_x1 = 0;
+    fb.clip_y1 = 0;
+    fb.clip_x2 = window_width;
+    fb.clip_y2 = window_height;
+    fb_fill_rect(&fb, 0, 0, window_width, window_height, fb_pack(clear_r, clear_g, clear_b, 255));
+    fb.clip_x1 = clip_left;
+    fb.clip_y1 = clip_top;
+    fb.clip_x2 = clip_right;
+    fb.clip_y2 = clip_bottom;
+    dirty_all();
+    return 1;
+}
+
+/**
+ * @brief Releases the CPU framebuffer.
+ */
+static void fb_destroy(void) {
+    if (fb.pixels) {
+        SDL_SIMDFree(fb.pixels);
+    }
+    fb.pixels = NULL;
+    fb.pitch = 0;
+}
+
+/* ====================================================================== */
+/*                  MIDPOINT RASTERIZER SECTION                           */
+/* ====================================================================== */
+
+/**
+ * @brief Receives the pixels of a rasterized outline.
+ */
+typedef void (*PointSink)(int x, int y);
+
+/**
+ * @brief Receives the horizontal span x1..x2 (inclusive, x1 <= x2) of a filled shape.
+ */
+typedef void (*SpanSink)(int x1, int x2, int y);
+
+/**
+ * @brief Emits the up to 8 symmetric points of a circle octant point, each only once.
+ */
+static void raster_circle_points(int cx, int cy, int px, int py, PointSink plot) {
+    plot(cx + px, cy + py);
+    if (px) plot(cx - px, cy + py);
+    if (py) plot(cx + px, cy - py);
+    if (px && py) plot(cx - px, cy - py);
+    if (px == py) return;
+    plot(cx + py, cy + px);
+    if (py) plot(cx - py, cy + px);
+    if (px) plot(cx + py, cy - px);
+    if (px && py) plot(cx - py, cy - px);
+}
+
+/**
+ * @brief Rasterizes a circle outline with the integer midpoint algorithm.
+ * Every pixel is emitted exactly once.
+ */
+static void raster_circle(int cx, int cy, int r, PointSink plot) {
+    if (r < 0) return;
+    int px = r, py = 0, err = 1 - r;
+    while (px >= py) {
+        raster_circle_points(cx, cy, px, py, plot);
+        py++;
+        if (err < 0) {
+            err += 2 * py + 1;
+        } else {
+            px--;
+            err += 2 * (py - px) + 1;
+        }
+    }
+}
+
+/**
+ * @brief Rasterizes a filled circle as one span per row.
+ *
+ * Runs the same midpoint walk as raster_circle(), so the spans end exactly
+ * at the outline pixels. Row py is final when it is visited, row px is final
+ * when px is about to step inwards.
+ */
+static void raster_fill_circle(int cx, int cy, int r, SpanSink span) {
+    if (r < 0) return;
+    int px = r, py = 0, err = 1 - r;
+    while (px >= py) {
+        span(cx - px, cx + px, cy + py);
+        if (py) span(cx - px, cx + px, cy - py);
+        if (err < 0) {
+            py++;
+            err += 2 * py + 1;
+        } else {
+            if (px != py) {
+                span(cx - py, cx + py, cy + px);
+                span(cx - py, cx + py, cy - px);
+            }
+            py++;
+            px--;
+            err += 2 * (py - px) + 1;
+        }
+    }
+}
+
+/**
+ * @brief State of a midpoint ellipse walk, see raster_ellipse_walk().
+ */
+typedef struct {
+    int cx, cy;       //!< Center.
+    PointSink plot;   //!< Receives the outline pixels, or NULL.
+    SpanSink span;    //!< Receives the filled rows, or NULL.
+    int row;          //!< Row offset of the quadrant row being collected.
+    int row_x;        //!< Widest x offset seen on that row.
+} EllipseWalk;
+
+/**
+ * @brief Emits the filled spans for the collected quadrant row, above and below the center.
+ */
+static void ellipse_emit_row(const EllipseWalk *w) {
+    w->span(w->cx - w->row_x, w->cx + w->row_x, w->cy + w->row);
+    if (w->row) w->span(w->cx - w->row_x, w->cx + w->row_x, w->cy - w->row);
+}
+
+/**
+ * @brief Visits one quadrant point of the walk.
+ *
+ * Points arrive with py falling and px growing, so a row is complete as soon
+ * as py changes and its last px is the widest.
+ */
+static void ellipse_visit(EllipseWalk *w, int px, int py) {
+    if (w->plot) {
+        // The up to 4 symmetric points, each only once
+        w->plot(w->cx + px, w->cy + py);
+        if (px) w->plot(w->cx - px, w->cy + py);
+        if (py) w->plot(w->cx + px, w->cy - py);
+        if (px && py) w->plot(w->cx - px, w->cy - py);
+    }
+    if (w->span) {
+        if (py != w->row) {
+            ellipse_emit_row(w);
+            w->row = py;
+        }
+        w->row_x = px;
+    }
+}
+
+/**
+ * @brief Walks an ellipse with the integer midpoint algorithm.
+ *
+ * The outline pixels go to plot, each exactly once, and one span per row,
+ * ending on the outline pixels, goes to span. Either sink may be NULL.
+ * The decision variables are scaled by 4 to stay integral and kept in 64 bits,
+ * which is enough for radii up to about 30000.
+ */
+static void raster_ellipse_walk(int cx, int cy, int rx, int ry, PointSink plot, SpanSink span) {
+    if (rx < 0 || ry < 0) return;
+    if (rx == 0 || ry == 0) {
+        for (int i = -ry; i <= ry; i++) {
+            if (plot) for (int j = -rx; j <= rx; j++) plot(cx + j, cy + i);
+            if (span) span(cx - rx, cx + rx, cy + i);
+        }
+        return;
+    }
+
+    EllipseWalk w = {cx, cy, plot, span, ry, 0};
+    Sint64 rx2 = (Sint64)rx * rx;
+    Sint64 ry2 = (Sint64)ry * ry;
+    int px = 0, py = ry;
+    Sint64 dx = 0;              // 2 * ry2 * px
+    Sint64 dy = 2 * rx2 * py;   // 2 * rx2 * py
+
+    // Region 1: the slope is above -1, step in x
+    Sint64 d = 4 * ry2 - 4 * rx2 * ry + rx2;
+    while (dx < dy) {
+        ellipse_visit(&w, px, py);
+        px++;
+        dx += 2 * ry2;
+        if (d < 0) {
+            d += 4 * (dx + ry2);
+        } else {
+            py--;
+            dy -= 2 * rx2;
+            d += 4 * (dx - dy + ry2);
+        }
+    }
+
+    // Region 2: the slope is below -1, step in y
+    d = ry2 * (2 * px + 1) * (2 * px + 1) + 4 * rx2 * (Sint64)(py - 1) * (py - 1) - 4 * rx2 * ry2;
+    while (py >= 0) {
+        ellipse_visit(&w, px, py);
+        if (py == 0) {
+            // Very flat ellipses reach the last row before x reaches rx
+            while (++px <= rx) ellipse_visit(&w, px, 0);
+            break;
+        }
+        py--;
+        dy -= 2 * rx2;
+        if (d > 0) {
+            d += 4 * (rx2 - dy);
+        } else {
+            px++;
+            dx += 2 * ry2;
+            d += 4 * (dx - dy + rx2);
+        }
+    }
+    if (span) ellipse_emit_row(&w);
+}
+
+/* ====================================================================== */
+/*                  TRIANGLE RASTERIZER SECTION                           */
+/* ====================================================================== */
+
+/**
+ * @brief Edge functions of a triangle, set up for sampling at pixel centers.
+ *
+ * Pixel (x, y) is covered when A[k] * x + B[k] * y + C[k] >= 0 for all three
+ * edges. The values are twice the edge function at (x + 0.5, y + 0.5), so
+ * integer vertices give exact integer tests. Edges that are not top or left
+ * edges are biased by -1, so a pixel center lying exactly on an edge shared
+ * by two triangles belongs to only one of them (top-left fill rule).
+ * Edge k runs from vertex k to vertex k + 1; its value is proportional to the
+ * barycentric weight of vertex k + 2.
+ */
+typedef struct {
+    int x1, y1, x2, y2;  //!< Pixel bounding box (inclusive), clipped.
+    int left;            //!< Leftmost column of the bounding box before clipping.
+    int vx[3], vy[3];    //!< Vertices in clockwise screen order.
+    Sint64 A[3];         //!< Change per pixel to the right.
+    Sint64 B[3];         //!< Change per row down.
+    Sint64 C[3];         //!< Value at pixel (0, 0).
+    Sint64 area2;        //!< Twice the triangle area, always positive.
+} TriEdges;
+
+/**
+ * @brief Sets up the edge functions and the bounding box clipped to
+ * [clip_x1, clip_x2) x [clip_y1, clip_y2).
+ * @return 1 if the triangle may cover any pixel, 0 if it is degenerate or clipped away.
+ */
+static int tri_setup(TriEdges *t, int x1, int y1, int x2, int y2, int x3, int y3,
+                     int clip_x1, int clip_y1, int clip_x2, int clip_y2) {
+    Sint64 area2 = (Sint64)(x2 - x1) * (y3 - y1) - (Sint64)(y2 - y1) * (x3 - x1);
+    if (area2 == 0) return 0;
+    if (area2 < 0) {
+        int tmp_x = x2; x2 = x3; x3 = tmp_x;
+        int tmp_y = y2; y2 = y3; y3 = tmp_y;
+        area2 = -area2;
+    }
+    t->area2 = area2;
+    t->vx[0] = x1; t->vx[1] = x2; t->vx[2] = x3;
+    t->vy[0] = y1; t->vy[1] = y2; t->vy[2] = y3;
+
+    for (int k = 0; k < 3; k++) {
+        int a = k, b = (k + 1) % 3;
+        Sint64 dx = t->vx[b] - t->vx[a];
+        Sint64 dy = t->vy[b] - t->vy[a];
+        int top_left = dy < 0 || (dy == 0 && dx > 0);
+        t->A[k] = -2 * dy;
+        t->B[k] = 2 * dx;
+        t->C[k] = -2 * dx * t->vy[a] + 2 * dy * t->vx[a] + dx - dy - (top_left ? 0 : 1);
+    }
+
+    // Pixel centers inside [min, max) of the vertices
+    int min_x = x1 < x2 ? (x1 < x3 ? x1 : x3) : (x2 < x3 ? x2 : x3);
+    int max_x = x1 > x2 ? (x1 > x3 ? x1 : x3) : (x2 > x3 ? x2 : x3);
+    int min_y = y1 < y2 ? (y1 < y3 ? y1 : y3) : (y2 < y3 ? y2 : y3);
+    int max_y = y1 > y2 ? (y1 > y3 ? y1 : y3) : (y2 > y3 ? y2 : y3);
+    t->left = min_x;
+    t->x1 = min_x > clip_x1 ? min_x : clip_x1;
+    t->y1 = min_y > clip_y1 ? min_y : clip_y1;
+    t->x2 = max_x < clip_x2 ? max_x - 1 : clip_x2 - 1;
+    t->y2 = max_y < clip_y2 ? max_y - 1 : clip_y2 - 1;
+    return t->x1 <= t->x2 && t->y1 <= t->y2;
+}
+
+/**
+ * @brief Rounds n / d towards minus infinity, d > 0.
+ */
+static inline Sint64 floor_div(Sint64 n, Sint64 d) {
+    return n >= 0 ? n / d : -((-n + d - 1) / d);
+}
+
+/**
+ * @brief Computes the exact covered span of row y within columns lo..hi.
+ *
+ * Each edge bounds x from one side, so the span is the intersection of three
+ * half-lines and lo..hi. This gives the same pixels as testing every
+ * pixel, at the cost of three divisions per row.
+ * @return 1 and the span in *xl..*xr, or 0 if the row is empty.
+ */
+static int tri_row_range(const TriEdges *t, int y, Sint64 lo, Sint64 hi, int *xl, int *xr) {
+    for (int k = 0; k < 3; k++) {
+        Sint64 a = t->A[k];
+        Sint64 c = t->B[k] * y + t->C[k];
+        if (a > 0) {
+            Sint64 bound = -floor_div(c, a); // ceil(-c / a)
+            if (bound > lo) lo = bound;
+        } else if (a < 0) {
+            Sint64 bound = floor_div(c, -a);
+            if (bound < hi) hi = bound;
+        } else if (c < 0) {
+            return 0;
+        }
+    }
+    if (lo > hi) return 0;
+    *xl = (int)lo;
+    *xr = (int)hi;
+    return 1;
+}
+
+/**
+ * @brief Computes the exact covered span of row y inside the clipped bounding box.
+ * @return 1 and the span in *xl..*xr, or 0 if the row is empty.
+ */
+static int tri_row_span(const TriEdges *t, int y, int *xl, int *xr) {
+    return tri_row_range(t, y, t->x1, t->x2, xl, xr);
+}
+
+/**
+ * @brief Fills a triangle in the framebuffer with the half-space rasterizer.
+ *
+ * The bounding box is walked in TRI_BLOCK x TRI_BLOCK blocks. Since the edge
+ * functions are linear, their extremes over a block are at its corners: blocks
+ * outside any edge are skipped, blocks inside all edges are filled without
+ * tests, and only blocks on an edge test every pixel with simd.tri_block, a
+ * block row at a time. Triangles too large for
+ * 32-bit edge values fall back to the exact row spans.
+ */
+static void fb_fill_triangle(const FbTarget *t, int x1, int y1, int x2, int y2, int x3, int y3, Uint32 color) {
+    TriEdges e;
+    if (!tri_setup(&e, x1, y1, x2, y2, x3, y3, t->clip_x1, t->clip_y1, t->clip_x2, t->clip_y2)) return;
+
+    int fits = 1;
+    for (int k = 0; k < 3; k++) {
+        Sint64 origin = e.A[k] * e.x1 + e.B[k] * e.y1 + e.C[k];
+        Sint64 reach = (origin < 0 ? -origin : origin) +
+                       (e.A[k] < 0 ? -e.A[k] : e.A[k]) * (e.x2 - e.x1 + TRI_BLOCK) +
+                       (e.B[k] < 0 ? -e.B[k] : e.B[k]) * (e.y2 - e.y1 + TRI_BLOCK);
+        if (reach > 0x7FFFFFFF) fits = 0;
+    }
+    if (!fits) {
+        for (int y = e.y1; y <= e.y2; y++) {
+            int xl, xr;
+            if (tri_row_span(&e, y, &xl, &xr)) fb_hline(t, xl, xr, y, color);
+        }
+        return;
+    }
+
+    int a[3], b[3], f0[3];
+    for (int k = 0; k < 3; k++) {
+        a[k] = (int)e.A[k];
+        b[k] = (int)e.B[k];
+        f0[k] = (int)(e.A[k] * e.x1 + e.B[k] * e.y1 + e.C[k]);
+    }
+
+    for (int by = e.y1; by <= e.y2; by += TRI_BLOCK) {
+        int bh = e.y2 - by + 1 < TRI_BLOCK ? e.y2 - by + 1 : TRI_BLOCK;
+        for (int bx = e.x1; bx <= e.x2; bx += TRI_BLOCK) {
+            int bw = e.x2 - bx + 1 < TRI_BLOCK ? e.x2 - bx + 1 : TRI_BLOCK;
+            int f[3];
+            int reject = 0, accept = 1;
+            for (int k = 0; k < 3; k++) {
+                f[k] = f0[k] + (bx - e.x1) * a[k] + (by - e.y1) * b[k];
+                int da = a[k] * (bw - 1), db = b[k] * (bh - 1);
+                int lo = f[k] + (da < 0 ? da : 0) + (db < 0 ? db : 0);
+                int hi = f[k] + (da > 0 ? da : 0) + (db > 0 ? db : 0);
+                if (hi < 0) reject = 1;
+                if (lo < 0) accept = 0;
+            }
+            if (reject) continue;
+
+            Uint32 *row = t->pixels + by * t->pitch + bx;
+            if (accept) {
+                for (int j = 0; j < bh; j++, row += t->pitch) {
+                    if (t->blend.mul) {
+                        simd.blend(row, bw, &t->blend);
+                    } else {
+                        simd.fill(row, bw, color);
+                    }
+                }
+                continue;
+            }
+            if (bw == TRI_BLOCK) {
+                simd.tri_block(row, t->pitch, bh, f, a, b, color, &t->blend);
+                continue;
+            }
+            for (int j = 0; j < bh; j++, row += t->pitch) {
+                for (int i = 0; i < bw; i++) {
+                    if (((f[0] + i * a[0]) | (f[1] + i * a[1]) | (f[2] + i * a[2])) >= 0) fb_put(t, &row[i], color);
+                }
+                f[0] += b[0];
+                f[1] += b[1];
+                f[2] += b[2];
+            }
+        }
+    }
+}
+
+/**
+ * @brief Color planes of a Gouraud shaded triangle.
+ *
+ * A channel at the center of pixel (x, y) is
+ * base + (num_x * (2x + 1 - 2 * x0) + num_y * (2y + 1 - 2 * y0)) / den,
+ * which is exactly the barycentric blend of the vertex colors.
+ */
+typedef struct {
+    int x0, y0;        //!< First vertex.
+    int base[3];       //!< R, G, B of the first vertex.
+    Sint64 num_x[3];   //!< Numerators of the x gradients.
+    Sint64 num_y[3];   //!< Numerators of the y gradients.
+    Sint64 den;        //!< Common denominator (four times the area), positive.
+    int step[3];       //!< Per pixel x gradients in 16.16 fixed point.
+} TriColors;
+
+/**
+ * @brief Sets up the color planes for vertex colors c[0..8] (r1, g1, b1, r2, ...).
+ */
+static void tri_colors_setup(TriColors *tc, int x1, int y1, int x2, int y2, int x3, int y3, const int c[9]) {
+    Sint64 area2 = (Sint64)(x2 - x1) * (y3 - y1) - (Sint64)(y2 - y1) * (x3 - x1);
+    int sign = area2 < 0 ? -1 : 1;
+    tc->x0 = x1;
+    tc->y0 = y1;
+    tc->den = 2 * area2 * sign;
+    for (int ch = 0; ch < 3; ch++) {
+        Sint64 d2 = c[3 + ch] - c[ch];
+        Sint64 d3 = c[6 + ch] - c[ch];
+        tc->base[ch] = c[ch];
+        tc->num_x[ch] = (d2 * (y3 - y1) - d3 * (y2 - y1)) * sign;
+        tc->num_y[ch] = (d3 * (x2 - x1) - d2 * (x3 - x1)) * sign;
+        // d/dx of the channel is 2 * num_x / den. Two covered pixels on a row
+        // differ by at most 255, so only slivers with one pixel per row reach the clamp.
+        Sint64 step = (tc->num_x[ch] * 2 * 65536) / tc->den;
+        if (step > (256 << 16)) step = 256 << 16;
+        if (step < -(256 << 16)) step = -(256 << 16);
+        tc->step[ch] = (int)step;
+    }
+}
+
+/**
+ * @brief Returns a channel at the center of pixel (x, y) in 16.16 fixed point,
+ * plus one half so that a later shift rounds to nearest.
+ */
+static inline int tri_color_at(const TriColors *tc, int ch, int x, int y) {
+    Sint64 n = tc->num_x[ch] * (2 * (Sint64)(x - tc->x0) + 1) + tc->num_y[ch] * (2 * (Sint64)(y - tc->y0) + 1);
+    return (tc->base[ch] << 16) + (int)floor_div(n * 65536, tc->den) + 0x8000;
+}
+
+/**
+ * @brief Rasterizes a Gouraud triangle into a pixel buffer.
+ *
+ * Coverage is the same as fb_fill_triangle(). Each row starts from an exact
+ * color at its unclipped left end, so rounding errors only build up along a
+ * single span and a pixel gets the same value however the row is clipped.
+ * @param pixels Pixel of (origin_x, origin_y).
+ * @param pitch Row length in pixels.
+ * @param alpha Opacity of the triangle, applied with blend mode mode.
+ */
+static void raster_gradient_triangle(const TriEdges *e, const TriColors *tc, Uint32 *pixels, int pitch,
+                                     int origin_x, int origin_y, int alpha, int mode) {
+    int blended = !(mode == SDLGFX_BLEND_NONE || (mode == SDLGFX_BLEND_ALPHA && alpha == 255));
+    for (int y = e->y1; y <= e->y2; y++) {
+        int xl, xr;
+        if (!tri_row_span(e, y, &xl, &xr)) continue;
+        int x0 = xl, unused;
+        if (xl == e->x1 && xl > e->left) tri_row_range(e, y, e->left, xr, &x0, &unused); // Clipped on the left
+        int c[3];
+        for (int ch = 0; ch < 3; ch++) {
+            c[ch] = tri_color_at(tc, ch, x0, y) + (int)((Sint64)(xl - x0) * tc->step[ch]);
+        }
+        Uint32 *dst = pixels + (Sint64)(y - origin_y) * pitch + (xl - origin_x);
+        if (!blended) {
+            simd.gradient(dst, xr - xl + 1, c[0], c[1], c[2], tc->step);
+            continue;
+        }
+        // Shade a chunk on the stack, then blend it onto the row
+        Uint32 chunk[256];
+        for (int x = 0; x <= xr - xl; x += 256) {
+            int n = xr - xl + 1 - x < 256 ? xr - xl + 1 - x : 256;
+            simd.gradient(chunk, n, c[0] + x * tc->step[0], c[1] + x * tc->step[1], c[2] + x * tc->step[2], tc->step);
+            simd.blend_colors(dst + x, chunk, n, alpha, mode);
+        }
+    }
+}
+
+/**
+ * @brief Draws a Gouraud triangle into a framebuffer target, clipped to its clip box.
+ * @param v Vertices x1, y1, x2, y2, x3, y3.
+ * @param colors Vertex colors r1, g1, b1, r2, ... (0-255), then the alpha of the triangle.
+ */
+static void fb_gradient_triangle(const FbTarget *t, const int v[6], const int colors[10], int mode) {
+    TriEdges e;
+    TriColors tc;
+    if (!tri_setup(&e, v[0], v[1], v[2], v[3], v[4], v[5], t->clip_x1, t->clip_y1, t->clip_x2, t->clip_y2)) return;
+    tri_colors_setup(&tc, v[0], v[1], v[2], v[3], v[4], v[5], colors);
+    raster_gradient_triangle(&e, &tc, t->pixels, t->pitch, 0, 0, colors[9], mode);
+}
+
+static SDL_Texture *gradient_texture = NULL; //!< Scratch streaming texture for shaded triangles on the renderer.
+
+/* ====================================================================== */
+/*                  TILE BINNING SECTION                                  */
+/* ====================================================================== */
+
+#define TILE_SIZE 64 //!< Side of a screen tile in pixels.
+
+/**
+ * @brief Kinds of binned framebuffer commands.
+ */
+enum {
+    TILE_PLOT,      //!< Pixel at (v[0], v[1]).
+    TILE_HLINE,     //!< Span from v[0] to v[1] on row v[2].
+    TILE_RECT,      //!< Rectangle with corner (v[0], v[1]) and size v[2] x v[3].
+    TILE_LINE,      //!< Line from (v[0], v[1]) to (v[2], v[3]), both ends included.
+    TILE_TRIANGLE,  //!< Filled triangle with vertices v[0..5].
+    TILE_GRADIENT,  //!< Gouraud triangle with vertices v[0..5].
+    TILE_GLYPH      //!< 8 pixel wide glyph at (v[0], v[1]), rows packed into v[2..5].
+};
+
+#define GLYPH_ROWS 16 //!< Most rows of a TILE_GLYPH, one byte each.
+
+/**
+ * @brief Returns row i of a TILE_GLYPH, the most significant bit is the leftmost pixel.
+ */
+static inline int glyph_row(const int *v, int i) {
+    return (int)(((Uint32)v[2 + i / 4] >> (8 * (i % 4))) & 0xFF);
+}
+
+/**
+ * @brief Draws a TILE_GLYPH into a framebuffer target, clipped to its clip box.
+ */
+static void fb_glyph(const FbTarget *t, const int v[6], Uint32 color) {
+    int x = v[0];
+    for (int i = 0; i < GLYPH_ROWS; i++) {
+        int y = v[1] + i, bits = glyph_row(v, i);
+        if (!bits || y < t->clip_y1 || y >= t->clip_y2) continue;
+        if (x >= t->clip_x1 && x + 8 <= t->clip_x2) {
+            simd.glyph(t->pixels + y * t->pitch + x, bits, color, &t->blend);
+            continue;
+        }
+        for (int j = 0; j < 8; j++) {
+            if (bits & (0x80 >> j)) fb_plot(t, x + j, y, color);
+        }
+    }
+}
+
+/**
+ * @brief A framebuffer drawing command.
+ */
+typedef struct {
+    int kind;      //!< One of the TILE_* kinds.
+    Uint32 color;  //!< RGBA8888 color, for TILE_GRADIENT the offset of its colors in tile_gradients.
+    int blend;     //!< SDLGFX_BLEND_* mode the color is drawn with.
+    int v[6];      //!< Coordinates, meaning depends on the kind.
+} TileCmd;
+
+/**
+ * @brief Commands that touch one tile, in drawing order.
+ */
+typedef struct {
+    int *cmds;     //!< Indices into tile_cmds.
+    int count;     //!< Number of binned commands.
+    int capacity;  //!< Allocated size of cmds.
+} TileBin;
+
+static int tile_threads = 1;             //!< Threads rasterizing a frame, 1 draws immediately.
+static TileCmd *tile_cmds = NULL;        //!< Commands binned for the current frame.
+static int tile_cmd_count = 0;           //!< Number of binned commands.
+static int tile_cmd_capacity = 0;        //!< Allocated size of tile_cmds.
+static int *tile_gradients = NULL;       //!< Vertex colors and alpha of TILE_GRADIENT commands, 10 per triangle.
+static int tile_gradient_count = 0;      //!< Number of ints used in tile_gradients.
+static int tile_gradient_capacity = 0;   //!< Allocated size of tile_gradients.
+static TileBin *tile_bins = NULL;        //!< One bin per tile, row by row.
+static int tiles_x = 0;                  //!< Tiles per row.
+static int tiles_y = 0;                  //!< Rows of tiles.
+static SDL_Thread **tile_workers = NULL; //!< Worker threads, the calling thread works too.
+static int tile_num_workers = 0;         //!< Number of running workers.
+static SDL_sem *tile_start = NULL;       //!< Posted once per worker to start a frame.
+static SDL_sem *tile_done = NULL;        //!< Posted by each worker when no tiles are left.
+static SDL_atomic_t tile_next;           //!< Next tile to be claimed.
+static int tile_quit = 0;                //!< Tells the workers to exit.
+
+/**
+ * @brief Runs one command on a framebuffer target.
+ * @param colors Vertex colors for TILE_GRADIENT, unused otherwise.
+ */
+static void fb_exec(const FbTarget *t, const TileCmd *cmd, const int *colors) {
+    const int *v = cmd->v;
+    if (cmd->kind == TILE_GRADIENT) {
+        fb_gradient_triangle(t, v, colors, cmd->blend);
+        return;
+    }
+    FbTarget bt = *t;
+    bt.blend = blend_setup(cmd->color, cmd->blend);
+    Uint32 color = bt.blend.add;
+    switch (cmd->kind) {
+        case TILE_PLOT:     fb_plot(&bt, v[0], v[1], color); break;
+        case TILE_HLINE:    fb_hline(&bt, v[0], v[1], v[2], color); break;
+        case TILE_RECT:     fb_fill_rect(&bt, v[0], v[1], v[2], v[3], color); break;
+        case TILE_LINE:     fb_line(&bt, v[0], v[1], v[2], v[3], color); break;
+        case TILE_TRIANGLE: fb_fill_triangle(&bt, v[0], v[1], v[2], v[3], v[4], v[5], color); break;
+        case TILE_GLYPH:    fb_glyph(&bt, v, color); break;
+    }
+}
+
+/**
+ * @brief Computes the inclusive bounding box of the pixels a command can write.
+ * @return 0 if the command draws nothing.
+ */
+static int fb_cmd_bounds(const TileCmd *cmd, int *x1, int *y1, int *x2, int *y2) {
+    const int *v = cmd->v;
+    int points = 2;
+    switch (cmd->kind) {
+        case TILE_PLOT:
+            points = 1;
+            break;
+        case TILE_HLINE:
+            *x1 = v[0] < v[1] ? v[0] : v[1];
+            *x2 = v[0] < v[1] ? v[1] : v[0];
+            *y1 = *y2 = v[2];
+            return 1;
+        case TILE_RECT:
+            if (v[2] <= 0 || v[3] <= 0) return 0;
+            *x1 = v[0];
+            *y1 = v[1];
+            *x2 = v[0] + v[2] - 1;
+            *y2 = v[1] + v[3] - 1;
+            return 1;
+        case TILE_TRIANGLE:
+        case TILE_GRADIENT:
+            points = 3;
+            break;
+        case TILE_GLYPH: {
+            int last = GLYPH_ROWS - 1;
+            while (last >= 0 && !glyph_row(v, last)) last--;
+            if (last < 0) return 0;
+            *x1 = v[0];
+            *y1 = v[1];
+            *x2 = v[0] + 7;
+            *y2 = v[1] + last;
+            return 1;
+        }
+    }
+    *x1 = *x2 = v[0];
+    *y1 = *y2 = v[1];
+    for (int i = 1; i < points; i++) {
+        if (v[2 * i] < *x1) *x1 = v[2 * i];
+        if (v[2 * i] > *x2) *x2 = v[2 * i];
+        if (v[2 * i + 1] < *y1) *y1 = v[2 * i + 1];
+        if (v[2 * i + 1] > *y2) *y2 = v[2 * i + 1];
+    }
+    return 1;
+}
+
+/**
+ * @brief Narrows x1..x2 to the columns a line can touch on rows y1..y2.
+ *
+ * Bresenham keeps every pixel within half a pixel of the true line along the
+ * minor axis, so the true line between y1 - 0.5 and y2 + 0.5, widened by one
+ * pixel, holds all of them.
+ */
+static void tile_line_columns(const int *v, int y1, int y2, int *x1, int *x2) {
+    if (v[1] == v[3]) return;
+    Sint64 dx = v[2] - v[0];
+    Sint64 dy2 = 2 * (Sint64)(v[3] - v[1]);
+    int xa = v[0] + (int)floor_div(dx * (2 * (Sint64)y1 - 1 - 2 * (Sint64)v[1]), dy2);
+    int xb = v[0] + (int)floor_div(dx * (2 * (Sint64)y2 + 1 - 2 * (Sint64)v[1]), dy2);
+    if (xa > xb) { int tmp = xa; xa = xb; xb = tmp; }
+    if (xa - 1 > *x1) *x1 = xa - 1;
+    if (xb + 1 < *x2) *x2 = xb + 1;
+}
+
+/**
+ * @brief Grows a bin array so it can hold at least count elements.
+ * @return 1 on success, 0 if the memory could not be allocated.
+ */
+static int tile_reserve(void **buffer, int *capacity, int count, size_t size, int initial) {
+    if (count <= *capacity) return 1;
+    int new_capacity = *capacity ? *capacity : initial;
+    while (new_capacity < count) new_capacity *= 2;
+    void *grown = realloc(*buffer, (size_t)new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "sdlgfx: Out of memory for tile bins, drawing directly.\n");
+        return 0;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+/**
+ * @brief Appends a command to the bins of every tile it can touch.
+ *
+ * The first pass only makes room, so a failed allocation leaves no tile with
+ * a partial frame.
+ * @param colors Vertex colors for TILE_GRADIENT, unused otherwise.
+ * @param x1, y1, x2, y2 Bounding box of the command (inclusive), clipped to the framebuffer.
+ * @return 1 if the command was binned, 0 if the caller must draw it.
+ */
+static int tile_record(const TileCmd *cmd, const int *colors, int x1, int y1, int x2, int y2) {
+    if (!tile_bins) {
+        tiles_x = (window_width + TILE_SIZE - 1) / TILE_SIZE;
+        tiles_y = (window_height + TILE_SIZE - 1) / TILE_SIZE;
+        tile_bins = (TileBin *)calloc((size_t)tiles_x * tiles_y, sizeof(TileBin));
+        if (!tile_bins) {
+            fprintf(stderr, "sdlgfx: Out of memory for tile bins, drawing directly.\n");
+            return 0;
+        }
+    }
+    if (!tile_reserve((void **)&tile_cmds, &tile_cmd_capacity, tile_cmd_count + 1, sizeof(TileCmd), 4096)) return 0;
+    if (cmd->kind == TILE_GRADIENT &&
+        !tile_reserve((void **)&tile_gradients, &tile_gradient_capacity, tile_gradient_count + 10, sizeof(int), 1024)) {
+        return 0;
+    }
+
+    for (int pass = 0; pass < 2; pass++) {
+        for (int ty = y1 / TILE_SIZE; ty <= y2 / TILE_SIZE; ty++) {
+            int bx1 = x1, bx2 = x2;
+            if (cmd->kind == TILE_LINE) {
+                int by1 = ty * TILE_SIZE > y1 ? ty * TILE_SIZE : y1;
+                int by2 = ty * TILE_SIZE + TILE_SIZE - 1 < y2 ? ty * TILE_SIZE + TILE_SIZE - 1 : y2;
+                tile_line_columns(cmd->v, by1, by2, &bx1, &bx2);
+                if (bx1 > bx2) continue;
+            }
+            for (int tx = bx1 / TILE_SIZE; tx <= bx2 / TILE_SIZE; tx++) {
+                TileBin *bin = &tile_bins[ty * tiles_x + tx];
+                if (pass == 1) {
+                    bin->cmds[bin->count++] = tile_cmd_count;
+                } else if (!tile_reserve((void **)&bin->cmds, &bin->capacity, bin->count + 1, sizeof(int), 256)) {
+                    return 0;
+                }
+            }
+        }
+    }
+
+    TileCmd *binned = &tile_cmds[tile_cmd_count++];
+    *binned = *cmd;
+    if (cmd->kind == TILE_GRADIENT) {
+        binned->color = (Uint32)tile_gradient_count;
+        memcpy(tile_gradients + tile_gradient_count, colors, 10 * sizeof(int));
+        tile_gradient_count += 10;
+    }
+    return 1;
+}
+
+/**
+ * @brief Drops all binned commands without drawing them.
+ */
+static void tile_discard(void) {
+    if (tile_bins) {
+        for (int i = 0; i < tiles_x * tiles_y; i++) tile_bins[i].count = 0;
+    }
+    tile_cmd_count = 0;
+    tile_gradient_count = 0;
+}
+
+/**
+ * @brief Replays the bin of one tile with writes clipped to that tile.
+ */
+static void tile_render(int index) {
+    const TileBin *bin = &tile_bins[index];
+    if (bin->count == 0) return;
+
+    int tx = index % tiles_x, ty = index / tiles_x;
+    FbTarget t = fb;
+    if (tx * TILE_SIZE > t.clip_x1) t.clip_x1 = tx * TILE_SIZE;
+    if (ty * TILE_SIZE > t.clip_y1) t.clip_y1 = ty * TILE_SIZE;
+    if ((tx + 1) * TILE_SIZE < t.clip_x2) t.clip_x2 = (tx + 1) * TILE_SIZE;
+    if ((ty + 1) * TILE_SIZE < t.clip_y2) t.clip_y2 = (ty + 1) * TILE_SIZE;
+
+    for (int i = 0; i < bin->count; i++) {
+        const TileCmd *cmd = &tile_cmds[bin->cmds[i]];
+        fb_exec(&t, cmd, cmd->kind == TILE_GRADIENT ? tile_gradients + cmd->color : NULL);
+    }
+}
+
+/**
+ * @brief Claims and renders tiles until none are left.
+ */
+static void tile_work(void) {
+    int num_tiles = tiles_x * tiles_y;
+    int index;
+    while ((index = SDL_AtomicAdd(&tile_next, 1)) < num_tiles) {
+        tile_render(index);
+    }
+}
+
+/**
+ * @brief Worker thread body: renders tiles once per started frame.
+ */
+static int tile_worker(void *data) {
+    (void)data;
+    while (1) {
+        SDL_SemWait(tile_start);
+        if (tile_quit) break;
+        tile_work();
+        SDL_SemPost(tile_done);
+    }
+    return 0;
+}
+
+/**
+ * @brief Stops and joins the worker threads.
+ */
+static void tile_stop_workers(void) {
+    tile_quit = 1;
+    for (int i = 0; i < tile_num_workers; i++) SDL_SemPost(tile_start);
+    for (int i = 0; i < tile_num_workers; i++) SDL_WaitThread(tile_workers[i], NULL);
+    tile_quit = 0;
+    tile_num_workers = 0;
+    free(tile_workers);
+    tile_workers = NULL;
+}
+
+/**
+ * @brief Starts tile_threads - 1 workers. If some cannot be created, the
+ * calling thread simply renders more tiles itself.
+ */
+static void tile_start_workers(void) {
+    if (tile_workers) return;
+    if (!tile_start) tile_start = SDL_CreateSemaphore(0);
+    if (!tile_done) tile_done = SDL_CreateSemaphore(0);
+    tile_workers = (SDL_Thread **)calloc((size_t)tile_threads - 1, sizeof(SDL_Thread *));
+    if (!tile_start || !tile_done || !tile_workers) {
+        fprintf(stderr, "sdlgfx: Failed to set up tile workers, rendering on one thread.\n");
+        return;
+    }
+    while (tile_num_workers < tile_threads - 1) {
+        SDL_Thread *thread = SDL_CreateThread(tile_worker, "sdlgfx_tiles", NULL);
+        if (!thread) {
+            fprintf(stderr, "sdlgfx: SDL_CreateThread Error: %s\n", SDL_GetError());
+            break;
+        }
+        tile_workers[tile_num_workers++] = thread;
+    }
+}
+
+/**
+ * @brief Renders all binned commands into the framebuffer and empties the bins.
+ *
+ * Tiles do not share pixels, so workers claim them in any order without locks,
+ * while each tile replays its own commands in drawing order.
+ */
+static void tile_resolve(void) {
+    if (tile_cmd_count == 0) return;
+    tile_start_workers();
+    SDL_AtomicSet(&tile_next, 0);
+    for (int i = 0; i < tile_num_workers; i++) SDL_SemPost(tile_start);
+    tile_work();
+    for (int i = 0; i < tile_num_workers; i++) SDL_SemWait(tile_done);
+    tile_discard();
+}
+
+/**
+ * @brief Stops the workers and frees the bins.
+ */
+static void tile_free(void) {
+    tile_stop_workers();
+    if (tile_start) SDL_DestroySemaphore(tile_start);
+    if (tile_done) SDL_DestroySemaphore(tile_done);
+    tile_start = NULL;
+    tile_done = NULL;
+    if (tile_bins) {
+        for (int i = 0; i < tiles_x * tiles_y; i++) free(tile_bins[i].cmds);
+    }
+    free(tile_bins);
+    free(tile_cmds);
+    free(tile_gradients);
+    tile_bins = NULL;
+    tile_cmds = NULL;
+    tile_gradients = NULL;
+    tiles_x = 0;
+    tiles_y = 0;
+    tile_cmd_count = 0;
+    tile_cmd_capacity = 0;
+    tile_gradient_count = 0;
+    tile_gradient_capacity = 0;
+}
+
+/**
+ * @brief Draws a command into the framebuffer, or bins it while tile threads are
+ * enabled, and marks its bounding box as changed.
+ * @param colors Vertex colors for TILE_GRADIENT, unused otherwise.
+ */
+static void fb_draw(const TileCmd *cmd, const int *colors) {
+    int x1, y1, x2, y2;
+    if (blend_is_noop(cmd->kind == TILE_GRADIENT ? (Uint32)colors[9] : cmd->color, cmd->blend)) return;
+    if (!fb_cmd_bounds(cmd, &x1, &y1, &x2, &y2)) return;
+    if (x1 < fb.clip_x1) x1 = fb.clip_x1;
+    if (y1 < fb.clip_y1) y1 = fb.clip_y1;
+    if (x2 >= fb.clip_x2) x2 = fb.clip_x2 - 1;
+    if (y2 >= fb.clip_y2) y2 = fb.clip_y2 - 1;
+    if (x1 > x2 || y1 > y2) return;
+
+    dirty_add(x1, y1, x2 + 1, y2 + 1);
+    if (tile_threads > 1 && tile_record(cmd, colors, x1, y1, x2, y2)) return;
+    tile_resolve(); // Whatever was binned before an allocation failure goes first
+    fb_exec(&fb, cmd, colors);
+}
+
+/* ====================================================================== */
+/*                  DEFERRED DRAWING SECTION                              */
+/* ====================================================================== */
+
+/**
+ * @brief Kinds of recorded draw commands.
+ */
+enum {
+    CMD_POINT,      //!< Single pixel at (x1, y1).
+    CMD_LINE,       //!< Line from (x1, y1) to (x2, y2), both ends included.
+    CMD_FILL_RECT   //!< Filled rectangle, x1/y1 is the corner and x2/y2 the size.
+};
+
+/**
+ * @brief A recorded draw command. Every command carries its own color,
+ * so sdlgfx_color() costs nothing while recording.
+ */
+typedef struct {
+    Uint32 color;        //!< Color packed as RGBA8888.
+    int kind;            //!< One of the CMD_* kinds.
+    int x1, y1, x2, y2;  //!< Coordinates, meaning depends on the kind.
+} DrawCmd;
+
+static int use_deferred = 0;           //!< Flag to record draw commands until sdlgfx_flush().
+static DrawCmd *cmd_buffer = NULL;     //!< Commands recorded for the current frame.
+static int cmd_count = 0;              //!< Number of recorded commands.
+static int cmd_capacity = 0;           //!< Allocated size of cmd_buffer and the scratch arrays.
+static SDL_Point *cmd_points = NULL;   //!< Scratch array for merged points and polylines.
+static SDL_Rect *cmd_rects = NULL;     //!< Scratch array for merged rectangles.
+
+/**
+ * @brief Sends the renderer a packed RGBA8888 color.
+ */
+static void set_render_color(Uint32 color) {
+    SDL_SetRenderDrawColor(sdlgfx_renderer, color >> 24, (color >> 16) & 0xFF, (color >> 8) & 0xFF, color & 0xFF);
+}
+
+/**
+ * @brief Drops all recorded commands without drawing them.
+ */
+static void deferred_discard(void) {
+    cmd_count = 0;
+}
+
+/**
+ * @brief Draws all recorded commands and empties the buffer.
+ *
+ * All recorded commands share the blend mode, since sdlgfx_set_blend_mode()
+ * submits the buffer before changing it. A run of consecutive commands with the
+ * same color is regrouped into one SDL_RenderDrawPoints call for points, one
+ * SDL_RenderFillRects call for rectangles and axis-aligned lines, and one
+ * SDL_RenderDrawLines call per chain of connected diagonal lines. This is safe
+ * while drawing a pixel again leaves it unchanged (SDLGFX_BLEND_NONE, or
+ * SDLGFX_BLEND_ALPHA with an opaque color). Otherwise a pixel covered by two
+ * commands must be blended twice, and the joints of a regrouped chain would be
+ * blended once, so every command is drawn on its own in recorded order.
+ */
+static void deferred_submit(void) {
+    if (cmd_count == 0) return;
+
+    int i = 0;
+    while (i < cmd_count) {
+        Uint32 color = cmd_buffer[i].color;
+        int regroup = draw_blend == SDLGFX_BLEND_NONE || (draw_blend == SDLGFX_BLEND_ALPHA && (color & 0xFF) == 0xFF);
+        int end = i + 1;
+        while (regroup && end < cmd_count && cmd_buffer[end].color == color) end++;
+
+        set_render_color(color);
+        int num_points = 0;
+        int num_rects = 0;
+
+        for (int k = i; k < end; k++) {
+            const DrawCmd *cmd = &cmd_buffer[k];
+            if (cmd->kind == CMD_FILL_RECT) {
+                SDL_Rect rect = {cmd->x1, cmd->y1, cmd->x2, cmd->y2};
+                cmd_rects[num_rects++] = rect;
+            } else if (cmd->kind == CMD_POINT || (cmd->x1 == cmd->x2 && cmd->y1 == cmd->y2)) {
+                SDL_Point point = {cmd->x1, cmd->y1};
+                cmd_points[num_points++] = point;
+            } else if (cmd->x1 == cmd->x2 || cmd->y1 == cmd->y2) {
+                // Axis-aligned lines are one pixel wide rectangles
+                SDL_Rect rect;
+                rect.x = cmd->x1 < cmd->x2 ? cmd->x1 : cmd->x2;
+                rect.y = cmd->y1 < cmd->y2 ? cmd->y1 : cmd->y2;
+                rect.w = abs(cmd->x2 - cmd->x1) + 1;
+                rect.h = abs(cmd->y2 - cmd->y1) + 1;
+                cmd_rects[num_rects++] = rect;
+            } else {
+                // Follow the chain of diagonal lines that start where the previous one ended.
+                // The chain is stored after the points collected so far.
+                SDL_Point *chain = cmd_points + num_points;
+                int chain_len = 0;
+                chain[chain_len].x = cmd->x1;
+                chain[chain_len].y = cmd->y1;
+                chain_len++;
+                while (1) {
+                    chain[chain_len].x = cmd_buffer[k].x2;
+                    chain[chain_len].y = cmd_buffer[k].y2;
+                    chain_len++;
+                    const DrawCmd *next = (k + 1 < end) ? &cmd_buffer[k + 1] : NULL;
+                    if (!next || next->kind != CMD_LINE || next->x1 == next->x2 || next->y1 == next->y2 ||
+                        next->x1 != cmd_buffer[k].x2 || next->y1 != cmd_buffer[k].y2) {
+                        break;
+                    }
+                    k++;
+                }
+                SDL_RenderDrawLines(sdlgfx_renderer, chain, chain_len);
+            }
+        }
+
+        if (num_points > 0) SDL_RenderDrawPoints(sdlgfx_renderer, cmd_points, num_points);
+        if (num_rects > 0) SDL_RenderFillRects(sdlgfx_renderer, cmd_rects, num_rects);
+        i = end;
+    }
+
+    cmd_count = 0;
+    SDL_SetRenderDrawColor(sdlgfx_renderer, current_color.r, current_color.g, current_color.b, current_color.a);
+}
+
+/**
+ * @brief Appends a command with the current color to the frame buffer.
+ * @return 1 if the command was recorded, 0 if the caller must draw it directly.
+ */
+static int deferred_record(int kind, int x1, int y1, int x2, int y2) {
+    if (cmd_count == cmd_capacity) {
+        int capacity = cmd_capacity ? cmd_capacity * 2 : 4096;
+        DrawCmd *commands = (DrawCmd *)realloc(cmd_buffer, capacity * sizeof(DrawCmd));
+        if (commands) cmd_buffer = commands;
+        // A chain of n lines needs n + 1 points
+        SDL_Point *points = commands ? (SDL_Point *)realloc(cmd_points, (capacity + 1) * sizeof(SDL_Point)) : NULL;
+        if (points) cmd_points = points;
+        SDL_Rect *rects = points ? (SDL_Rect *)realloc(cmd_rects, capacity * sizeof(SDL_Rect)) : NULL;
+        if (rects) cmd_rects = rects;
+        if (!rects) {
+            fprintf(stderr, "sdlgfx: Out of memory for deferred commands, drawing directly.\n");
+            deferred_submit();
+            return 0;
+        }
+        cmd_capacity = capacity;
+    }
+
+    DrawCmd *cmd = &cmd_buffer[cmd_count++];
+    cmd->color = packed_color;
+    cmd->kind = kind;
+    cmd->x1 = x1;
+    cmd->y1 = y1;
+    cmd->x2 = x2;
+    cmd->y2 = y2;
+    return 1;
+}
+
+/**
+ * @brief Frees the command buffer and its scratch arrays.
+ */
+static void deferred_free(void) {
+    free(cmd_buffer);
+    free(cmd_points);
+    free(cmd_rects);
+    cmd_buffer = NULL;
+    cmd_points = NULL;
+    cmd_rects = NULL;
+    cmd_count = 0;
+    cmd_capacity = 0;
+}
+
+/* ====================================================================== */
+/*                  BATCH DRAWING SECTION                                 */
+/* ====================================================================== */
+
+/**
+ * @brief Shape kinds accepted by the array based drawing functions.
+ */
+enum {
+    BATCH_POINTS,   //!< x, y
+    BATCH_LINES,    //!< x1, y1, x2, y2
+    BATCH_RECTS,    //!< x1, y1, x2, y2
+    BATCH_CIRCLES   //!< x, y, radius
+};
+
+static const int batch_stride[] = {2, 4, 4, 3}; //!< Ints per shape for each BATCH_* kind.
+
+static SDL_Point *batch_points = NULL; //!< Points of the color group being built.
+static int batch_num_points = 0;       //!< Number of points in batch_points.
+static int batch_points_capacity = 0;  //!< Allocated size of batch_points.
+static SDL_Rect *batch_rects = NULL;   //!< Rectangles of the color group being built.
+static int batch_num_rects = 0;        //!< Number of rectangles in batch_rects.
+static int batch_rects_capacity = 0;   //!< Allocated size of batch_rects.
+static Uint64 *batch_keys = NULL;      //!< Shape indices sorted by color (color << 32 | index).
+static int batch_keys_capacity = 0;    //!< Allocated size of batch_keys.
+static Uint32 batch_color = 0;         //!< RGBA8888 color of the group being built.
+
+/**
+ * @brief Grows a scratch array so it can hold at least count elements.
+ * @return 1 on success, 0 if the memory could not be allocated.
+ */
+static int batch_reserve(void **buffer, int *capacity, int count, size_t size) {
+    if (count <= *capacity) return 1;
+    int new_capacity = *capacity ? *capacity : 1024;
+    while (new_capacity < count) new_capacity *= 2;
+    void *grown = realloc(*buffer, (size_t)new_capacity * size);
+    if (!grown) {
+        fprintf(stderr, "sdlgfx: Out of memory for batch drawing.\n");
+        return 0;
+    }
+    *buffer = grown;
+    *capacity = new_capacity;
+    return 1;
+}
+
+/**
+ * @brief Draws the points and rectangles collected for the current color group.
+ */
+static void batch_submit(void) {
+    if (batch_num_points == 0 && batch_num_rects == 0) return;
+    set_render_color(batch_color);
+    if (batch_num_points > 0) SDL_RenderDrawPoints(sdlgfx_renderer, batch_points, batch_num_points);
+    if (batch_num_rects > 0) SDL_RenderFillRects(sdlgfx_renderer, batch_rects, batch_num_rects);
+    batch_num_points = 0;
+    batch_num_rects = 0;
+}
+
+/**
+ * @brief Adds a point to the current group, submitting early if memory runs out.
+ */
+static void batch_add_point(int x, int y) {
+    if (batch_num_points == batch_points_capacity &&
+        !batch_reserve((void **)&batch_points, &batch_points_capacity, batch_num_points + 1, sizeof(SDL_Point))) {
+        batch_submit();
+        if (batch_points_capacity == 0) return;
+    }
+    batch_points[batch_num_points].x = x;
+    batch_points[batch_num_points].y = y;
+    batch_num_points++;
+}
+
+/**
+ * @brief Adds a rectangle to the current group, submitting early if memory runs out.
+ */
+static void batch_add_rect(int x, int y, int w, int h) {
+    if (!clip_rectangle(&x, &y, &w, &h)) return;
+    if (batch_num_rects == batch_rects_capacity &&
+        !batch_reserve((void **)&batch_rects, &batch_rects_capacity, batch_num_rects + 1, sizeof(SDL_Rect))) {
+        batch_submit();
+        if (batch_rects_capacity == 0) return;
+    }
+    SDL_Rect rect = {x, y, w, h};
+    batch_rects[batch_num_rects++] = rect;
+}
+
+/**
+ * @brief Point sink that plots into the framebuffer or adds to the current group.
+ */
+static void batch_point(int x, int y) {
+    if (!clip_contains(x, y)) return;
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_PLOT, batch_color, draw_blend, {x, y}};
+        fb_draw(&cmd, NULL);
+    } else {
+        batch_add_point(x, y);
+    }
+}
+
+/**
+ * @brief Fills a rectangle in the framebuffer or adds it to the current group.
+ */
+static void batch_rect(int x, int y, int w, int h) {
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_RECT, batch_color, draw_blend, {x, y, w, h}};
+        fb_draw(&cmd, NULL);
+    } else {
+        batch_add_rect(x, y, w, h);
+    }
+}
+
+/**
+ * @brief Point sink for single shapes: also honours the deferred command buffer.
+ */
+static void shape_point(int x, int y) {
+    if (!clip_contains(x, y)) return;
+    if (!fb.pixels && use_deferred && deferred_record(CMD_POINT, x, y, x, y)) return;
+    batch_point(x, y);
+}
+
+/**
+ * @brief Rectangle output for single shapes: also honours the deferred command buffer.
+ */
+static void shape_rect(int x, int y, int w, int h) {
+    if (!clip_rectangle(&x, &y, &w, &h)) return;
+    if (!fb.pixels && use_deferred && deferred_record(CMD_FILL_RECT, x, y, w, h)) return;
+    batch_rect(x, y, w, h);
+}
+
+/**
+ * @brief A horizontal span x1..x2 (inclusive) on row y.
+ */
+typedef struct {
+    int y;
+    int x1, x2;
+} Span;
+
+static Span *span_buffer = NULL;  //!< Spans of the filled shape being rasterized.
+static int span_count = 0;        //!< Number of spans in span_buffer.
+static int span_capacity = 0;     //!< Allocated size of span_buffer.
+static void (*span_output)(int x, int y, int w, int h) = batch_rect; //!< Receives the merged rectangles.
+
+static void span_flush(void);
+
+/**
+ * @brief Span sink that collects the parts of the spans of one filled shape
+ * inside the clip box.
+ */
+static void span_add(int x1, int x2, int y) {
+    if (y < clip_top || y >= clip_bottom) return;
+    if (x1 > x2) { int tmp = x1; x1 = x2; x2 = tmp; }
+    if (x1 < clip_left) x1 = clip_left;
+    if (x2 >= clip_right) x2 = clip_right - 1;
+    if (x1 > x2) return;
+    if (span_count == span_capacity &&
+        !batch_reserve((void **)&span_buffer, &span_capacity, span_count + 1, sizeof(Span))) {
+        // Draw what we have, overlaps with later spans are merely painted twice
+        span_flush();
+        if (span_capacity == 0) return;
+    }
+    Span *sp = &span_buffer[span_count++];
+    sp->y = y;
+    sp->x1 = x1;
+    sp->x2 = x2;
+}
+
+/**
+ * @brief Orders spans top to bottom, then left to right.
+ */
+static int span_compare(const void *a, const void *b) {
+    const Span *sa = (const Span *)a;
+    const Span *sb = (const Span *)b;
+    if (sa->y != sb->y) return (sa->y > sb->y) - (sa->y < sb->y);
+    return (sa->x1 > sb->x1) - (sa->x1 < sb->x1);
+}
+
+/**
+ * @brief Merges the collected spans into rectangles and hands them to span_output.
+ *
+ * Overlapping or touching spans on the same row become one span, so no pixel
+ * is painted twice, and equal spans on consecutive rows become one taller
+ * rectangle. A circle of radius r ends up as far fewer than 2r + 1 rectangles.
+ */
+static void span_flush(void) {
+    if (span_count == 0) return;
+
+    int sorted = 1;
+    for (int i = 1; i < span_count && sorted; i++) {
+        sorted = span_compare(&span_buffer[i - 1], &span_buffer[i]) <= 0;
+    }
+    if (!sorted) qsort(span_buffer, span_count, sizeof(Span), span_compare);
+
+    // The rectangle being grown, emitted when the next span cannot extend it
+    int rx = 0, ry = 0, rw = 0, rh = 0;
+    int i = 0;
+    while (i < span_count) {
+        int y = span_buffer[i].y;
+        int x1 = span_buffer[i].x1;
+        int x2 = span_buffer[i].x2;
+        for (i++; i < span_count && span_buffer[i].y == y && span_buffer[i].x1 <= x2 + 1; i++) {
+            if (span_buffer[i].x2 > x2) x2 = span_buffer[i].x2;
+        }
+        if (rh > 0 && rx == x1 && rw == x2 - x1 + 1 && ry + rh == y) {
+            rh++;
+            continue;
+        }
+        if (rh > 0) span_output(rx, ry, rw, rh);
+        rx = x1;
+        ry = y;
+        rw = x2 - x1 + 1;
+        rh = 1;
+    }
+    if (rh > 0) span_output(rx, ry, rw, rh);
+    span_count = 0;
+}
+
+/**
+ * @brief Adds the pixels of the line x1,y1 - x2,y2 (both ends included) that
+ * lie in the clip box to the current shape, one span per row.
+ *
+ * The outlines built from several lines go through the spans, so a pixel
+ * shared by two segments is merged by span_flush() and blended only once.
+ */
+static void span_line(int x1, int y1, int x2, int y2) {
+    LineWalk w;
+    if (!line_clip(&w, x1, y1, x2, y2, clip_left, clip_top, clip_right, clip_bottom)) return;
+    int run_x = w.x, last_x = w.x, y = w.y;
+    for (int i = 1; i < w.count; i++) {
+        line_step(&w);
+        if (w.y != y) {
+            span_add(run_x, last_x, y);
+            run_x = w.x;
+            y = w.y;
+        }
+        last_x = w.x;
+    }
+    span_add(run_x, last_x, y);
+}
+
+/**
+ * @brief Starts a single shape drawn with the current color through shape_point()/span_add().
+ */
+static void shape_begin(void) {
+    batch_color = packed_color;
+    span_output = shape_rect;
+}
+
+/**
+ * @brief Draws what a single shape collected: the merged spans and the points,
+ * as one points and one rects call on the renderer.
+ */
+static void shape_end(void) {
+    span_flush();
+    if (batch_num_points == 0 && batch_num_rects == 0) return;
+    batch_submit();
+    SDL_SetRenderDrawColor(sdlgfx_renderer, current_color.r, current_color.g, current_color.b, current_color.a);
+}
+
+/**
+ * @brief Draws one shape into the framebuffer, or adds its pixels to the current group.
+ *
+ * Lines use the same clipped Bresenham walk as fb_line(), so both backends
+ * produce the same pixels. Axis-aligned lines become one pixel wide rectangles.
+ */
+static void batch_add_shape(int kind, const int *v) {
+    switch (kind) {
+    case BATCH_POINTS:
+        batch_point(v[0], v[1]);
+        break;
+    case BATCH_RECTS:
+        batch_rect(v[0], v[1], v[2] - v[0], v[3] - v[1]);
+        break;
+    case BATCH_LINES: {
+        int x1 = v[0], y1 = v[1], x2 = v[2], y2 = v[3];
+        if (fb.pixels) {
+            TileCmd cmd = {TILE_LINE, batch_color, draw_blend, {x1, y1, x2, y2}};
+            fb_draw(&cmd, NULL);
+        } else if (x1 == x2 || y1 == y2) {
+            batch_add_rect(x1 < x2 ? x1 : x2, y1 < y2 ? y1 : y2, abs(x2 - x1) + 1, abs(y2 - y1) + 1);
+        } else {
+            LineWalk w;
+            if (!line_clip(&w, x1, y1, x2, y2, clip_left, clip_top, clip_right, clip_bottom)) break;
+            for (int i = 0; i < w.count; i++) {
+                batch_add_point(w.x, w.y);
+                line_step(&w);
+            }
+        }
+        break;
+    }
+    case BATCH_CIRCLES:
+        if (!clip_overlaps(v[0] - v[2], v[1] - v[2], v[0] + v[2], v[1] + v[2])) break;
+        raster_fill_circle(v[0], v[1], v[2], span_add);
+        span_flush();
+        break;
+    }
+}
+
+/**
+ * @brief Orders shape indices by color using a stable sort.
+ */
+static int batch_key_compare(const void *a, const void *b) {
+    Uint64 ka = *(const Uint64 *)a;
+    Uint64 kb = *(const Uint64 *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * @brief Draws an array of shapes with one renderer call per color group.
+ *
+ * Without colors every shape uses the current color. With colors the shapes
+ * are grouped by color, keeping their original order inside each group.
+ * Shapes of different colors that overlap may therefore be painted in a
+ * different order than given.
+ *
+ * @param kind One of the BATCH_* kinds.
+ * @param data Shape coordinates, batch_stride[kind] ints per shape.
+ * @param colors Packed 0xRRGGBB color per shape with the current alpha, or NULL for the current color.
+ * @param count Number of shapes.
+ */
+static void batch_draw(int kind, const int *data, const Uint32 *colors, int count) {
+    if (!data || count <= 0) return;
+    int stride = batch_stride[kind];
+    span_output = batch_rect;
+
+    if (fb.pixels) {
+        // The framebuffer has no per-call cost, draw in the given order
+        for (int i = 0; i < count; i++) {
+            batch_color = colors ? ((colors[i] & 0xFFFFFF) << 8) | (packed_color & 0xFF) : packed_color;
+            batch_add_shape(kind, data + i * stride);
+        }
+        return;
+    }
+
+    deferred_submit(); // Recorded commands were issued first
+
+    if (colors && batch_reserve((void **)&batch_keys, &batch_keys_capacity, count, sizeof(Uint64))) {
+        // The index in the low bits keeps the sort stable
+        for (int i = 0; i < count; i++) {
+            batch_keys[i] = ((Uint64)(colors[i] & 0xFFFFFF) << 32) | (Uint32)i;
+        }
+        qsort(batch_keys, count, sizeof(Uint64), batch_key_compare);
+        for (int i = 0; i < count; i++) {
+            Uint32 color = ((Uint32)(batch_keys[i] >> 32) << 8) | (packed_color & 0xFF);
+            if (color != batch_color) batch_submit();
+            batch_color = color;
+            batch_add_shape(kind, data + (int)(batch_keys[i] & 0xFFFFFFFF) * stride);
+        }
+    } else {
+        // Single color, or no memory to sort: group runs of equal color
+        for (int i = 0; i < count; i++) {
+            Uint32 color = colors ? ((colors[i] & 0xFFFFFF) << 8) | (packed_color & 0xFF) : packed_color;
+            if (color != batch_color) batch_submit();
+            batch_color = color;
+            batch_add_shape(kind, data + i * stride);
+        }
+    }
+    batch_submit();
+
+    SDL_SetRenderDrawColor(sdlgfx_renderer, current_color.r, current_color.g, current_color.b, current_color.a);
+}
+
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+static SDL_Vertex *geometry_vertices = NULL; //!< Vertices handed to SDL_RenderGeometry.
+static int geometry_capacity = 0;            //!< Allocated size of geometry_vertices.
+#endif
+
+/**
+ * @brief Draws triangles with SDL_RenderGeometry, the renderer interpolates the vertex colors.
+ *
+ * Only available when built against SDL 2.0.18 or newer.
+ * @param xy Two ints per vertex.
+ * @param colors Packed 0xRRGGBB per vertex, or NULL for the current color.
+ * @param num_vertices Number of vertices.
+ * @param indices Three vertex indices per triangle, or NULL to take the vertices in order.
+ * @param num_indices Number of indices.
+ * @return 1 if the renderer drew the triangles, 0 if the caller must rasterize them.
+ */
+static int geometry_draw(const int *xy, const Uint32 *colors, int num_vertices, const int *indices, int num_indices) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    if (!batch_reserve((void **)&geometry_vertices, &geometry_capacity, num_vertices, sizeof(SDL_Vertex))) return 0;
+    for (int i = 0; i < num_vertices; i++) {
+        SDL_Vertex *v = &geometry_vertices[i];
+        v->position.x = (float)xy[i * 2];
+        v->position.y = (float)xy[i * 2 + 1];
+        if (colors) {
+            v->color.r = (colors[i] >> 16) & 0xFF;
+            v->color.g = (colors[i] >> 8) & 0xFF;
+            v->color.b = colors[i] & 0xFF;
+        } else {
+            v->color.r = current_color.r;
+            v->color.g = current_color.g;
+            v->color.b = current_color.b;
+        }
+        v->color.a = current_color.a;
+        v->tex_coord.x = 0.0f;
+        v->tex_coord.y = 0.0f;
+    }
+    deferred_submit(); // Recorded commands were issued first
+    return SDL_RenderGeometry(sdlgfx_renderer, NULL, geometry_vertices, num_vertices, indices, num_indices) == 0;
+#else
+    (void)xy; (void)colors; (void)num_vertices; (void)indices; (void)num_indices;
+    return 0;
+#endif
+}
+
+/**
+ * @brief Frees the scratch arrays used by the batch functions.
+ */
+static void batch_free(void) {
+    free(batch_points);
+    free(batch_rects);
+    free(batch_keys);
+    free(span_buffer);
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+    free(geometry_vertices);
+    geometry_vertices = NULL;
+    geometry_capacity = 0;
+#endif
+    batch_points = NULL;
+    batch_rects = NULL;
+    batch_keys = NULL;
+    span_buffer = NULL;
+    batch_num_points = 0;
+    batch_num_rects = 0;
+    batch_points_capacity = 0;
+    batch_rects_capacity = 0;
+    batch_keys_capacity = 0;
+    span_count = 0;
+    span_capacity = 0;
+}
+
+/* ====================================================================== */
+/*                  POLYGON SECTION                                       */
+/* ====================================================================== */
+
+/**
+ * @brief A non-horizontal polygon edge in the edge table.
+ *
+ * Rows are sampled at their centers like the triangle rasterizer: the edge
+ * crosses rows y1..y2 and a pixel is inside a span when its center lies at or
+ * right of the left crossing and left of the right one. The first covered
+ * column, ceil(crossing - 0.5) = ceil(num / den), is stepped exactly with an
+ * integer quotient and remainder.
+ */
+typedef struct {
+    int y1, y2;       //!< First and last crossed row.
+    int winding;      //!< +1 for edges going down, -1 for edges going up.
+    int x0, y0;       //!< Upper end point.
+    int dx, dy;       //!< Vector to the lower end point, dy > 0.
+    int x;            //!< First column right of the crossing on the current row.
+    Sint64 q, r;      //!< num = q * den + r with 0 <= r < den.
+    Sint64 step_q;    //!< Quotient of the per row step of num.
+    Sint64 step_r;    //!< Remainder of the per row step of num.
+} PolyEdge;
+
+static PolyEdge *poly_edges = NULL;    //!< Edge table, sorted by first row.
+static int poly_edges_capacity = 0;    //!< Allocated size of poly_edges.
+static PolyEdge **poly_active = NULL;  //!< Active edges, sorted by x on the current row.
+static int poly_active_capacity = 0;   //!< Allocated size of poly_active.
+
+/**
+ * @brief Places an edge on row y.
+ */
+static void poly_edge_start(PolyEdge *e, int y) {
+    Sint64 den = 2 * (Sint64)e->dy;
+    Sint64 num = 2 * (Sint64)e->x0 * e->dy + (Sint64)e->dx * (2 * ((Sint64)y - e->y0) + 1) - e->dy;
+    e->q = floor_div(num, den);
+    e->r = num - e->q * den;
+    e->x = (int)(e->q + (e->r > 0));
+}
+
+/**
+ * @brief Moves an edge to the next row.
+ */
+static void poly_edge_step(PolyEdge *e) {
+    e->q += e->step_q;
+    e->r += e->step_r;
+    if (e->r >= 2 * (Sint64)e->dy) {
+        e->q++;
+        e->r -= 2 * (Sint64)e->dy;
+    }
+    e->x = (int)(e->q + (e->r > 0));
+}
+
+/**
+ * @brief Orders edges by their first row.
+ */
+static int poly_edge_compare(const void *a, const void *b) {
+    const PolyEdge *ea = (const PolyEdge *)a;
+    const PolyEdge *eb = (const PolyEdge *)b;
+    return (ea->y1 > eb->y1) - (ea->y1 < eb->y1);
+}
+
+/**
+ * @brief Scan converts a polygon into spans passed to span_add().
+ *
+ * Edges are sorted by their first row into an edge table. Walking down the
+ * rows, edges move from the table into the active list when they start and
+ * drop out after their last row; the list is kept sorted by x with an
+ * insertion sort, which is nearly free because edges rarely swap places.
+ * Spans are clipped to [clip_x1, clip_x2) x [clip_y1, clip_y2).
+ * @param rule SDLGFX_EVEN_ODD or SDLGFX_NONZERO.
+ */
+static void raster_polygon(const int *xy, int count, int rule, int clip_x1, int clip_y1, int clip_x2, int clip_y2) {
+    if (!batch_reserve((void **)&poly_edges, &poly_edges_capacity, count, sizeof(PolyEdge))) return;
+    if (!batch_reserve((void **)&poly_active, &poly_active_capacity, count, sizeof(PolyEdge *))) return;
+
+    int num_edges = 0;
+    for (int i = 0; i < count; i++) {
+        int ax = xy[2 * i], ay = xy[2 * i + 1];
+        int bx = xy[(2 * i + 2) % (2 * count)], by = xy[(2 * i + 3) % (2 * count)];
+        if (ay == by) continue; // Horizontal edges never cross a row center
+        PolyEdge *e = &poly_edges[num_edges++];
+        e->winding = ay < by ? 1 : -1;
+        if (ay > by) {
+            int tmp_x = ax; ax = bx; bx = tmp_x;
+            int tmp_y = ay; ay = by; by = tmp_y;
+        }
+        e->x0 = ax;
+        e->y0 = ay;
+        e->dx = bx - ax;
+        e->dy = by - ay;
+        e->y1 = ay;
+        e->y2 = by - 1;
+        e->step_q = floor_div(2 * (Sint64)e->dx, 2 * (Sint64)e->dy);
+        e->step_r = 2 * (Sint64)e->dx - e->step_q * 2 * e->dy;
+    }
+    if (num_edges == 0) return;
+    qsort(poly_edges, num_edges, sizeof(PolyEdge), poly_edge_compare);
+
+    int y_end = clip_y2 - 1;
+    int y = poly_edges[0].y1 > clip_y1 ? poly_edges[0].y1 : clip_y1;
+    int next_edge = 0;
+    int num_active = 0;
+
+    for (; y <= y_end; y++) {
+        // Drop finished edges, step the others
+        int kept = 0;
+        for (int i = 0; i < num_active; i++) {
+            if (poly_active[i]->y2 < y) continue;
+            poly_edge_step(poly_active[i]);
+            poly_active[kept++] = poly_active[i];
+        }
+        num_active = kept;
+
+        // Activate edges starting on this row (or above the clip box)
+        while (next_edge < num_edges && poly_edges[next_edge].y1 <= y) {
+            PolyEdge *e = &poly_edges[next_edge++];
+            if (e->y2 < y) continue;
+            poly_edge_start(e, y);
+            poly_active[num_active++] = e;
+        }
+        if (num_active == 0) {
+            if (next_edge == num_edges) break;
+            y = poly_edges[next_edge].y1 - 1; // Skip the gap
+            continue;
+        }
+
+        for (int i = 1; i < num_active; i++) {
+            PolyEdge *e = poly_active[i];
+            int j = i;
+            while (j > 0 && poly_active[j - 1]->x > e->x) {
+                poly_active[j] = poly_active[j - 1];
+                j--;
+            }
+            poly_active[j] = e;
+        }
+
+        int winding = 0;
+        for (int i = 0; i + 1 < num_active; i++) {
+            winding += rule == SDLGFX_NONZERO ? poly_active[i]->winding : 1;
+            int inside = rule == SDLGFX_NONZERO ? winding != 0 : (winding & 1);
+            if (!inside) continue;
+            int x1 = poly_active[i]->x;
+            int x2 = poly_active[i + 1]->x - 1;
+            if (x1 < clip_x1) x1 = clip_x1;
+            if (x2 >= clip_x2) x2 = clip_x2 - 1;
+            if (x1 <= x2) span_add(x1, x2, y);
+        }
+    }
+}
+
+/**
+ * @brief Frees the edge table.
+ */
+static void polygon_free(void) {
+    free(poly_edges);
+    free(poly_active);
+    poly_edges = NULL;
+    poly_active = NULL;
+    poly_edges_capacity = 0;
+    poly_active_capacity = 0;
+}
+
+/* ====================================================================== */
+/*                  FRAME PIPELINE SECTION                                */
+/* ====================================================================== */
+
+#define PIPE_FRESH 4 //!< Flag in pipe_state: the ready frame was not taken yet.
+
+/**
+ * @brief Draws one frame of the pipeline into CPU memory.
+ */
+typedef void (*PipelineFunc)(Uint32 *pixels, int pitch, int width, int height, float time, int technique);
+
+static Uint32 *pipe_frames[3] = {NULL, NULL, NULL}; //!< Triple buffer of RGBA8888 frames.
+static int pipe_pitch = 0;               //!< Row length of the frames in pixels.
+static int pipe_width = 0;               //!< Width of the frames.
+static int pipe_height = 0;              //!< Height of the frames.
+static int pipe_front = 0;               //!< Frame owned by the main thread.
+static int pipe_back = 0;                //!< Frame owned by the worker.
+static SDL_atomic_t pipe_state;          //!< Index of the ready frame, plus PIPE_FRESH.
+static SDL_atomic_t pipe_technique;      //!< Technique passed to pipe_func.
+static SDL_atomic_t pipe_quit;           //!< Tells the worker to exit.
+static SDL_sem *pipe_taken = NULL;       //!< Posted when the main thread takes a frame.
+static SDL_Thread *pipe_thread = NULL;   //!< Worker drawing the frames.
+static PipelineFunc pipe_func = NULL;    //!< The user's frame callback.
+static SDL_Texture *pipe_texture = NULL; //!< Holds the front frame for the renderer.
+static int pipe_shown = 0;               //!< Flag: the front frame holds a finished frame.
+
+/**
+ * @brief Worker thread body: draws frames into the back buffer and publishes them.
+ *
+ * A frame is published only after the previous one was taken, so the worker
+ * runs exactly one frame ahead of the main thread and no frame is dropped.
+ */
+static int pipe_worker(void *data) {
+    (void)data;
+    while (!SDL_AtomicGet(&pipe_quit)) {
+        pipe_func(pipe_frames[pipe_back], pipe_pitch, pipe_width, pipe_height,
+                  SDL_GetTicks() / 1000.0f, SDL_AtomicGet(&pipe_technique));
+        SDL_SemWait(pipe_taken);
+        if (SDL_AtomicGet(&pipe_quit)) break;
+        SDL_MemoryBarrierRelease(); // The pixels are complete before the frame is visible
+        pipe_back = SDL_AtomicSet(&pipe_state, pipe_back | PIPE_FRESH) & 3;
+    }
+    return 0;
+}
+
+/**
+ * @brief Swaps the newest published frame into pipe_front.
+ * @return 1 if a new frame was taken, 0 if the worker has not finished one since.
+ */
+static int pipe_take(void) {
+    if (!(SDL_AtomicGet(&pipe_state) & PIPE_FRESH)) return 0;
+    SDL_MemoryBarrierRelease(); // Done reading the old front frame
+    pipe_front = SDL_AtomicSet(&pipe_state, pipe_front) & 3;
+    SDL_MemoryBarrierAcquire();
+    SDL_SemPost(pipe_taken);
+    pipe_shown = 1;
+    return 1;
+}
+
+/**
+ * @brief Stops the worker and frees the frames.
+ */
+static void pipe_free(void) {
+    if (pipe_thread) {
+        SDL_AtomicSet(&pipe_quit, 1);
+        SDL_SemPost(pipe_taken); // Wakes the worker if it waits to publish
+        SDL_WaitThread(pipe_thread, NULL);
+        pipe_thread = NULL;
+    }
+    if (pipe_taken) SDL_DestroySemaphore(pipe_taken);
+    pipe_taken = NULL;
+    if (pipe_texture) SDL_DestroyTexture(pipe_texture);
+    pipe_texture = NULL;
+    for (int i = 0; i < 3; i++) {
+        if (pipe_frames[i]) SDL_SIMDFree(pipe_frames[i]);
+        pipe_frames[i] = NULL;
+    }
+    pipe_func = NULL;
+    pipe_shown = 0;
+}
+
+/* ====================================================================== */
+/*                  FRAME PACING SECTION                                  */
+/* ====================================================================== */
+
+#define PACE_SPIN_MS 2 //!< Milliseconds before the deadline where sleeping stops and spinning starts.
+
+static int present_mode = SDLGFX_PRESENT_VSYNC; //!< How sdlgfx_flush() presents frames.
+static double present_rate = 60.0;      //!< Target frames per second in SDLGFX_PRESENT_PACED mode.
+static Uint64 pace_deadline = 0;        //!< Performance counter value the next paced frame waits for.
+static Uint64 pace_last = 0;            //!< Performance counter value of the previous present, 0 before the first.
+static Uint64 pace_frames = 0;          //!< Frame intervals measured since the last reset.
+static Uint64 pace_total = 0;           //!< Sum of the measured intervals in counter ticks.
+static Uint64 pace_min = 0;             //!< Shortest measured interval in counter ticks.
+static Uint64 pace_max = 0;             //!< Longest measured interval in counter ticks.
+static Uint64 pace_late = 0;            //!< Paced frames that reached sdlgfx_flush() after their deadline.
+
+/**
+ * @brief Waits for the deadline of the next paced frame.
+ *
+ * Sleeps with SDL_Delay() while more than PACE_SPIN_MS remain, since the OS
+ * may wake the thread a millisecond or more late, then spins on the
+ * performance counter for the rest. Deadlines advance by exactly one period,
+ * so rounding never accumulates; a frame more than one period late restarts
+ * the schedule instead of rushing the following frames to catch up.
+ */
+static void pace_wait(void) {
+    Uint64 freq = SDL_GetPerformanceFrequency();
+    Uint64 period = (Uint64)(freq / present_rate);
+    Uint64 margin = freq * PACE_SPIN_MS / 1000;
+    Uint64 now = SDL_GetPerformanceCounter();
+
+    if (pace_deadline == 0 || now > pace_deadline + period) {
+        if (pace_deadline) pace_late++;
+        pace_deadline = now + period;
+        return;
+    }
+    if (now > pace_deadline) {
+        pace_late++;
+    } else {
+        while (pace_deadline - now > margin) {
+            Uint32 ms = (Uint32)((pace_deadline - now - margin) * 1000 / freq);
+            if (ms == 0) break;
+            SDL_Delay(ms);
+            now = SDL_GetPerformanceCounter();
+            if (now >= pace_deadline) break;
+        }
+        while (SDL_GetPerformanceCounter() < pace_deadline) {
+            // Spin: the remaining time is shorter than the sleep granularity
+        }
+    }
+    pace_deadline += period;
+}
+
+/**
+ * @brief Records the interval since the previous present.
+ */
+static void pace_measure(void) {
+    Uint64 now = SDL_GetPerformanceCounter();
+    if (pace_last) {
+        Uint64 interval = now - pace_last;
+        if (pace_frames == 0 || interval < pace_min) pace_min = interval;
+        if (interval > pace_max) pace_max = interval;
+        pace_total += interval;
+        pace_frames++;
+    }
+    pace_last = now;
+}
+
+/* ====================================================================== */
+/*                  READBACK SECTION                                      */
+/* ====================================================================== */
+
+static Uint32 *snapshot_pixels = NULL; //!< RGBA8888 copy of the renderer's frame, window sized.
+static int snapshot_valid = 0;         //!< Flag: snapshot_pixels matches the frame drawn so far.
+
+/**
+ * @brief Copies a region of the frame drawn so far as RGBA8888.
+ *
+ * The CPU framebuffer and the surfaces of the software renderer are read
+ * directly. An accelerated renderer is read back once into snapshot_pixels,
+ * which is reused until the next draw call, so thousands of pixel queries
+ * between two draws cost one SDL_RenderReadPixels.
+ *
+ * @param x, y, w, h The region, inside the window.
+ * @param dst Receives the pixels.
+ * @param dst_pitch Row length of dst in pixels.
+ * @return 1 on success, 0 on error.
+ */
+static int read_pixels(int x, int y, int w, int h, Uint32 *dst, int dst_pitch) {
+    const Uint32 *src;
+    int src_pitch;
+
+    if (fb.pixels) {
+        tile_resolve();
+        src = fb.pixels + y * fb.pitch + x;
+        src_pitch = fb.pitch;
+    } else {
+        deferred_submit();
+        SDL_Surface *surface = offscreen_surface ? offscreen_surface : window_surface;
+        if (surface) {
+#if SDL_VERSION_ATLEAST(2, 0, 10)
+            SDL_RenderFlush(sdlgfx_renderer); // The surface is written when batched commands run
+#endif
+            const Uint8 *row = (const Uint8 *)surface->pixels + y * surface->pitch + x * surface->format->BytesPerPixel;
+            return SDL_ConvertPixels(w, h, surface->format->format, row, surface->pitch,
+                                     SDL_PIXELFORMAT_RGBA8888, dst, dst_pitch * (int)sizeof(Uint32)) == 0;
+        }
+        if (!snapshot_valid) {
+            if (!snapshot_pixels) {
+                snapshot_pixels = (Uint32 *)SDL_malloc((size_t)window_width * window_height * sizeof(Uint32));
+                if (!snapshot_pixels) {
+                    fprintf(stderr, "sdlgfx: Failed to allocate readback snapshot.\n");
+                    return 0;
+                }
+            }
+            if (SDL_RenderReadPixels(sdlgfx_renderer, NULL, SDL_PIXELFORMAT_RGBA8888, snapshot_pixels,
+                                     window_width * (int)sizeof(Uint32)) != 0) {
+                fprintf(stderr, "sdlgfx: SDL_RenderReadPixels failed: %s\n", SDL_GetError());
+                return 0;
+            }
+            snapshot_valid = 1;
+        }
+        src = snapshot_pixels + y * window_width + x;
+        src_pitch = window_width;
+    }
+
+    for (int row = 0; row < h; row++) {
+        memcpy(dst + row * dst_pitch, src + row * src_pitch, w * sizeof(Uint32));
+    }
+    return 1;
+}
+
+/**
+ * @brief Releases the readback snapshot.
+ */
+static void snapshot_free(void) {
+    SDL_free(snapshot_pixels);
+    snapshot_pixels = NULL;
+    snapshot_valid = 0;
+}
 
 /* ====================================================================== */
 /*                  EXPORTED LIBRARY FUNCTIONS                           */
@@ -76,6 +2897,69 @@ static SDL_Color current_color = {0, 0, 0, 255}; //!< Current drawing color.
 static int use_streaming_texture = 0; //!< Flag to use streaming texture.
 static void *locked_pixels = NULL;     //!< Pointer to locked pixel data.
 static int locked_pitch = 0;         //!< Pitch of the locked texture.
+static int locked_framebuffer = 0;   //!< Flag: locked_pixels points into the CPU framebuffer.
+static SDL_Texture *locked_texture = NULL; //!< Texture holding locked_pixels.
+static int use_window_surface = 0;   //!< Flag: sdlgfx_open() draws into the window surface instead of a texture.
+static SDL_Rect surface_rects[DIRTY_MAX]; //!< Window surface regions written by the current flush.
+static int surface_rect_count = 0;   //!< Number of regions in surface_rects.
+
+#define TEXTURE_RING_MAX 3 //!< Most streaming textures used in turn.
+
+static SDL_Texture *texture_ring[TEXTURE_RING_MAX]; //!< Streaming textures used in turn, one of them is sdlgfx_texture.
+static int texture_ring_size = 1;    //!< Requested number of streaming textures.
+static int texture_ring_count = 0;   //!< Textures in texture_ring, 0 while the ring is off.
+static int texture_back = 0;         //!< Ring slot written by the next full lock.
+
+/**
+ * @brief Creates sdlgfx_texture with the access type required by the current mode.
+ *
+ * The framebuffer backend uploads whole frames, so it always needs a streaming texture.
+ *
+ * @return The new texture, or NULL on error.
+ */
+static SDL_Texture *create_texture(void) {
+    int access = (use_streaming_texture || use_framebuffer) ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET;
+    SDL_Texture *texture = SDL_CreateTexture(sdlgfx_renderer, SDL_PIXELFORMAT_RGBA8888, access, window_width, window_height);
+    if (texture && use_framebuffer) {
+        SDL_SetTextureBlendMode(texture, SDL_BLENDMODE_NONE); // Frames are opaque, skip blending on copy
+        dirty_all(); // A new texture holds none of the frame yet
+    }
+    return texture;
+}
+
+/**
+ * @brief Destroys the ring textures except the one shown as sdlgfx_texture.
+ */
+static void texture_ring_free(void) {
+    for (int i = 0; i < texture_ring_count; i++) {
+        if (texture_ring[i] != sdlgfx_texture) SDL_DestroyTexture(texture_ring[i]);
+        texture_ring[i] = NULL;
+    }
+    texture_ring_count = 0;
+    texture_back = 0;
+}
+
+/**
+ * @brief Builds the ring around sdlgfx_texture when streaming with more than one texture.
+ *
+ * The framebuffer keeps a single texture: it uploads only what changed since
+ * the last frame, which every texture of a ring would have to hold.
+ */
+static void texture_ring_setup(void) {
+    texture_ring_free();
+    if (!sdlgfx_texture || !use_streaming_texture || use_framebuffer || texture_ring_size < 2) return;
+    texture_ring[0] = sdlgfx_texture;
+    texture_ring_count = 1;
+    while (texture_ring_count < texture_ring_size) {
+        SDL_Texture *texture = create_texture();
+        if (!texture) {
+            fprintf(stderr, "sdlgfx: Failed to create ring texture: %s\n", SDL_GetError());
+            break;
+        }
+        texture_ring[texture_ring_count++] = texture;
+    }
+    texture_back = 1 % texture_ring_count;
+}
 
 /**
  * @brief Enables or disables streaming texture usage.
@@ -85,13 +2969,315 @@ void sdlgfx_set_streaming_texture(int enable) {
     use_streaming_texture = enable;
     if (sdlgfx_renderer && sdlgfx_texture) {
         // Recreate texture with new access type if renderer and texture already exist
+        texture_ring_free();
         SDL_DestroyTexture(sdlgfx_texture);
-        int access = use_streaming_texture ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET;
-        sdlgfx_texture = SDL_CreateTexture(sdlgfx_renderer, SDL_PIXELFORMAT_RGBA8888, access, window_width, window_height);
+        sdlgfx_texture = create_texture();
         if (!sdlgfx_texture) {
             fprintf(stderr, "sdlgfx_set_streaming_texture: SDL_CreateTexture Error: %s\n", SDL_GetError());
         }
+        texture_ring_setup();
+    }
+}
+
+static void clip_update(void);
+
+/**
+ * @brief Enables or disables the CPU framebuffer backend.
+ *
+ * When enabled, every sdlgfx_* primitive writes pixels into an aligned RGBA8888
+ * buffer in memory and sdlgfx_flush() uploads it with one SDL_UpdateTexture.
+ * May be called before or after sdlgfx_open().
+ *
+ * @param enable 1 to enable the framebuffer, 0 to draw through the SDL renderer.
+ */
+void sdlgfx_set_framebuffer(int enable) {
+    if (use_framebuffer == (enable != 0)) return;
+    use_framebuffer = (enable != 0);
+
+    if (!sdlgfx_renderer) return; // Applied by sdlgfx_open()
+
+    if (use_framebuffer) {
+        if (!fb_create()) {
+            use_framebuffer = 0;
+            return;
+        }
+    } else {
+        tile_discard();
+        fb_destroy();
+    }
+
+    if (sdlgfx_texture) {
+        texture_ring_free();
+        SDL_DestroyTexture(sdlgfx_texture);
+        sdlgfx_texture = create_texture();
+        if (!sdlgfx_texture) {
+            fprintf(stderr, "sdlgfx_set_framebuffer: SDL_CreateTexture Error: %s\n", SDL_GetError());
+        }
+        texture_ring_setup();
+    }
+    clip_update(); // The renderer clip rect is only used without the framebuffer
+}
+
+/**
+ * @brief Selects the window surface backend for the next sdlgfx_open().
+ *
+ * The window then gets a software renderer on its own surface instead of an
+ * accelerated renderer, so nothing goes through a texture. Renderer and
+ * window surface cannot be mixed on an open window, so this takes effect at
+ * the next sdlgfx_open().
+ *
+ * @param enable 1 to draw into the window surface, 0 for the SDL renderer.
+ */
+void sdlgfx_set_window_surface(int enable) {
+    use_window_surface = (enable != 0);
+    if (sdlgfx_window && (window_surface != NULL) != use_window_surface) {
+        fprintf(stderr, "sdlgfx_set_window_surface: Warning: takes effect at the next sdlgfx_open().\n");
+    }
+}
+
+/**
+ * @brief Copies the changed framebuffer regions into the window surface.
+ *
+ * Each region is converted straight to the surface format and remembered in
+ * surface_rects, so only those rows are sent to the screen.
+ */
+static void surface_copy_dirty(void) {
+    if (SDL_MUSTLOCK(window_surface) && SDL_LockSurface(window_surface) != 0) {
+        fprintf(stderr, "sdlgfx: Failed to lock window surface: %s\n", SDL_GetError());
+        return;
+    }
+    Uint32 format = window_surface->format->format;
+    surface_rect_count = 0;
+    for (int i = 0; i < dirty_count; i++) {
+        const DirtyRect *d = &dirty_rects[i];
+        const Uint32 *src = fb.pixels + d->y1 * fb.pitch + d->x1;
+        Uint8 *dst = (Uint8 *)window_surface->pixels + d->y1 * window_surface->pitch + d->x1 * window_surface->format->BytesPerPixel;
+        int w = d->x2 - d->x1, h = d->y2 - d->y1;
+        if (format == SDL_PIXELFORMAT_RGBA8888) {
+            for (int y = 0; y < h; y++) memcpy(dst + y * window_surface->pitch, src + y * fb.pitch, w * sizeof(Uint32));
+        } else {
+            SDL_ConvertPixels(w, h, SDL_PIXELFORMAT_RGBA8888, src, fb.pitch * (int)sizeof(Uint32), format, dst, window_surface->pitch);
+        }
+        surface_rects[surface_rect_count++] = (SDL_Rect){d->x1, d->y1, w, h};
+    }
+    dirty_count = 0;
+    if (SDL_MUSTLOCK(window_surface)) SDL_UnlockSurface(window_surface);
+}
+
+/**
+ * @brief Enables or disables deferred (recorded) drawing.
+ *
+ * While enabled, sdlgfx_point, sdlgfx_line, sdlgfx_rectangle, sdlgfx_fill_rectangle
+ * and sdlgfx_color only append to a per-frame command buffer, which is drawn in
+ * merged batches by sdlgfx_flush() or sdlgfx_submit(). Disabling submits pending commands.
+ *
+ * @param enable 1 to record draw commands, 0 to draw immediately.
+ */
+void sdlgfx_set_deferred(int enable) {
+    if (!enable && use_deferred && sdlgfx_renderer) {
+        deferred_submit();
+    }
+    use_deferred = (enable != 0);
+}
+
+/**
+ * @brief Draws all recorded commands without presenting the frame.
+ */
+void sdlgfx_submit(void) {
+    snapshot_valid = 0;
+    if (sdlgfx_renderer) {
+        deferred_submit();
+    }
+}
+
+/**
+ * @brief Sets how many threads rasterize the CPU framebuffer.
+ *
+ * With more than one thread, framebuffer primitives are binned into 64x64
+ * tiles and drawn by sdlgfx_flush(), one tile per thread at a time.
+ *
+ * @param count Number of threads including the caller, 0 for one per CPU core, 1 to draw immediately.
+ */
+void sdlgfx_set_threads(int count) {
+    if (count <= 0) count = SDL_GetCPUCount();
+    if (count < 1) count = 1;
+    if (count > 64) count = 64;
+    if (count == tile_threads) return;
+    if (fb.pixels) tile_resolve(); // Pending tiles use the old workers
+    tile_stop_workers();
+    tile_threads = count;
+}
+
+/**
+ * @brief Caps the instruction set of the framebuffer kernels.
+ *
+ * Takes effect at the next sdlgfx_open(), while no worker can be drawing.
+ *
+ * @param level One of the SDLGFX_SIMD_* levels.
+ */
+void sdlgfx_set_simd(int level) {
+    if (level < SDLGFX_SIMD_SCALAR || level > SDLGFX_SIMD_AVX2) {
+        fprintf(stderr, "sdlgfx: Unknown SIMD level %d.\n", level);
+        return;
+    }
+    simd_limit = level;
+}
+
+/**
+ * @brief Returns the SDLGFX_SIMD_* level of the active kernels.
+ */
+int sdlgfx_get_simd(void) {
+    return simd_level;
+}
+
+/**
+ * @brief Returns the name of a SDLGFX_SIMD_* level.
+ */
+const char *sdlgfx_simd_name(int level) {
+    if (level < SDLGFX_SIMD_SCALAR || level > SDLGFX_SIMD_AVX2) return "unknown";
+    return simd_names[level];
+}
+
+/**
+ * @brief Recomputes the clip box from the window and user_clip, and hands it
+ * to the framebuffer or the renderer.
+ *
+ * With the framebuffer the renderer keeps no clip rect: the framebuffer clips
+ * by itself, and sdlgfx_flush() must copy the whole frame to the window.
+ */
+static void clip_update(void) {
+    int x1 = 0, y1 = 0, x2 = window_width, y2 = window_height;
+    if (use_clip) {
+        if (user_clip.x > x1) x1 = user_clip.x;
+        if (user_clip.y > y1) y1 = user_clip.y;
+        if (user_clip.x + user_clip.w < x2) x2 = user_clip.x + user_clip.w;
+        if (user_clip.y + user_clip.h < y2) y2 = user_clip.y + user_clip.h;
+        if (x2 < x1) x2 = x1;
+        if (y2 < y1) y2 = y1;
+    }
+
+    if (sdlgfx_renderer) {
+        deferred_submit(); // Recorded commands were issued under the old clip
+        if (fb.pixels) tile_resolve(); // Binned commands are clipped when their tiles are rendered
+        SDL_Rect rect = {x1, y1, x2 - x1, y2 - y1};
+        SDL_RenderSetClipRect(sdlgfx_renderer, use_clip && !fb.pixels ? &rect : NULL);
+    }
+    clip_left = x1;
+    clip_top = y1;
+    clip_right = x2;
+    clip_bottom = y2;
+    if (fb.pixels) {
+        fb.clip_x1 = x1;
+        fb.clip_y1 = y1;
+        fb.clip_x2 = x2;
+        fb.clip_y2 = y2;
+    }
+}
+
+/**
+ * @brief Limits all drawing to a rectangle of the window.
+ *
+ * Primitives are clipped before they are rasterized or sent to the renderer,
+ * and shapes entirely outside the rectangle are skipped at once, so drawing
+ * costs in proportion to what is visible. sdlgfx_clear() still clears the
+ * whole window, like SDL_RenderClear. May be called before sdlgfx_open().
+ *
+ * @param x Left edge.
+ * @param y Top edge.
+ * @param w Width, 0 or less clips everything away.
+ * @param h Height, 0 or less clips everything away.
+ */
+void sdlgfx_set_clip(int x, int y, int w, int h) {
+    user_clip.x = x;
+    user_clip.y = y;
+    user_clip.w = w > 0 ? w : 0;
+    user_clip.h = h > 0 ? h : 0;
+    use_clip = 1;
+    clip_update();
+}
+
+/**
+ * @brief Removes the clip rectangle, drawing may cover the whole window again.
+ */
+void sdlgfx_reset_clip(void) {
+    use_clip = 0;
+    clip_update();
+}
+
+/**
+ * @brief Sets how many streaming textures are used in turn.
+ *
+ * With a ring, each full-window sdlgfx_lock_texture_pixels() writes the texture
+ * after the one last shown, so the CPU fills frame N + 1 while the GPU may
+ * still read frame N, and the driver has no reason to stall the lock.
+ * sdlgfx_unlock_texture_pixels() then makes the written texture sdlgfx_texture.
+ * Only affects the streaming texture, see sdlgfx_set_streaming_texture().
+ *
+ * @param count Number of textures, 1 (the default) to 3.
+ */
+void sdlgfx_set_texture_ring(int count) {
+    if (count < 1) count = 1;
+    if (count > TEXTURE_RING_MAX) count = TEXTURE_RING_MAX;
+    if (locked_texture) {
+        fprintf(stderr, "sdlgfx_set_texture_ring: Texture is locked. Unlock it first.\n");
+        return;
+    }
+    texture_ring_size = count;
+    if (sdlgfx_renderer) texture_ring_setup();
+}
+
+/**
+ * @brief Returns the texture the next full-window lock writes into.
+ * @return The back texture of the ring, or sdlgfx_texture without a ring.
+ */
+SDL_Texture *sdlgfx_get_back_texture(void) {
+    return texture_ring_count > 1 ? texture_ring[texture_back] : sdlgfx_texture;
+}
+
+/**
+ * @brief Maps an SDLGFX_BLEND_* mode to the renderer blend mode.
+ */
+static SDL_BlendMode blend_sdl_mode(int mode) {
+    switch (mode) {
+        case SDLGFX_BLEND_NONE: return SDL_BLENDMODE_NONE;
+        case SDLGFX_BLEND_ADD:  return SDL_BLENDMODE_ADD;
+#if SDL_VERSION_ATLEAST(2, 0, 12)
+        case SDLGFX_BLEND_MUL:  return SDL_BLENDMODE_MUL;
+#else
+        case SDLGFX_BLEND_MUL:  return SDL_BLENDMODE_MOD; // Same as multiply for opaque colors
+#endif
+        default:                return SDL_BLENDMODE_BLEND;
+    }
+}
+
+/**
+ * @brief Creates the texture and drawing state for a freshly created renderer.
+ * @return 1 on success, 0 if the texture could not be created.
+ */
+static int open_setup(void) {
+    simd_select();
+    sdlgfx_texture = create_texture();
+
+    if (sdlgfx_texture == NULL) {
+        fprintf(stderr, "SDL_CreateTexture Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    if (use_framebuffer && !fb_create()) {
+        use_framebuffer = 0;
+        SDL_DestroyTexture(sdlgfx_texture);
+        sdlgfx_texture = create_texture();
     }
+    clip_update();
+    texture_ring_setup();
+    pace_deadline = 0;
+    pace_last = 0;
+
+    SDL_SetRenderTarget(sdlgfx_renderer, NULL);
+    SDL_SetRenderDrawBlendMode(sdlgfx_renderer, blend_sdl_mode(draw_blend));
+    sdlgfx_clear_color(clear_r, clear_g, clear_b);
+    sdlgfx_clear();
+    return 1;
 }
 
 /**
@@ -103,7 +3289,7 @@ void sdlgfx_set_streaming_texture(int enable) {
  * @param y Initial Y position.
  */
 void sdlgfx_open(int width, int height, const char *title, int x, int y) {
-    if (sdlgfx_window != NULL) {
+    if (sdlgfx_renderer != NULL) {
         fprintf(stderr, "sdlgfx_open: Warning: graphics window already open.\n");
         return;
     }
@@ -126,88 +3312,351 @@ void sdlgfx_open(int width, int height, const char *title, int x, int y) {
         return;
     }
 
-    sdlgfx_renderer = SDL_CreateRenderer(sdlgfx_window, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC);
+    if (use_window_surface) {
+        // Primitives are drawn straight into the surface SDL shows, in its native format
+        window_surface = SDL_GetWindowSurface(sdlgfx_window);
+        sdlgfx_renderer = window_surface ? SDL_CreateSoftwareRenderer(window_surface) : NULL;
+    } else {
+        Uint32 renderer_flags = SDL_RENDERER_ACCELERATED;
+        if (present_mode == SDLGFX_PRESENT_VSYNC) renderer_flags |= SDL_RENDERER_PRESENTVSYNC;
+        sdlgfx_renderer = SDL_CreateRenderer(sdlgfx_window, -1, renderer_flags);
+    }
 
     if (sdlgfx_renderer == NULL) {
         fprintf(stderr, "SDL_CreateRenderer Error: %s\n", SDL_GetError());
         SDL_DestroyWindow(sdlgfx_window);
+        sdlgfx_window = NULL;
+        window_surface = NULL;
         SDL_Quit();
         return;
     }
 
-    int access = use_streaming_texture ? SDL_TEXTUREACCESS_STREAMING : SDL_TEXTUREACCESS_TARGET;
-    sdlgfx_texture = SDL_CreateTexture(sdlgfx_renderer, SDL_PIXELFORMAT_RGBA8888, access, width, height);
-
-    if (sdlgfx_texture == NULL) {
-        fprintf(stderr, "SDL_CreateTexture Error: %s\n", SDL_GetError());
+    if (!open_setup()) {
         SDL_DestroyRenderer(sdlgfx_renderer);
+        sdlgfx_renderer = NULL;
         SDL_DestroyWindow(sdlgfx_window);
+        sdlgfx_window = NULL;
+        window_surface = NULL;
         SDL_Quit();
         return;
     }
-
-    SDL_SetRenderTarget(sdlgfx_renderer, NULL);
-    SDL_SetRenderDrawBlendMode(sdlgfx_renderer, SDL_BLENDMODE_BLEND);
-    sdlgfx_clear_color(clear_r, clear_g, clear_b);
-    sdlgfx_clear();
     fprintf(stdout, "SDL graphics window opened successfully: %dx%d pixels.\n", window_width, window_height);
 }
 
+/**
+ * @brief Opens a headless drawing target without a window.
+ *
+ * The SDL software renderer draws into a memory surface, so no video
+ * subsystem or display is needed.
+ *
+ * @param width Width of the target in pixels.
+ * @param height Height of the target in pixels.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_open_offscreen(int width, int height) {
+    if (sdlgfx_renderer != NULL) {
+        fprintf(stderr, "sdlgfx_open_offscreen: Warning: graphics window already open.\n");
+        return 0;
+    }
+
+    window_width = width;
+    window_height = height;
+
+    offscreen_surface = SDL_CreateRGBSurfaceWithFormat(0, width, height, 32, SDL_PIXELFORMAT_RGBA8888);
+
+    if (offscreen_surface == NULL) {
+        fprintf(stderr, "SDL_CreateRGBSurfaceWithFormat Error: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    sdlgfx_renderer = SDL_CreateSoftwareRenderer(offscreen_surface);
+
+    if (sdlgfx_renderer == NULL) {
+        fprintf(stderr, "SDL_CreateSoftwareRenderer Error: %s\n", SDL_GetError());
+        SDL_FreeSurface(offscreen_surface);
+        offscreen_surface = NULL;
+        return 0;
+    }
+
+    if (!open_setup()) {
+        SDL_DestroyRenderer(sdlgfx_renderer);
+        sdlgfx_renderer = NULL;
+        SDL_FreeSurface(offscreen_surface);
+        offscreen_surface = NULL;
+        return 0;
+    }
+    fprintf(stdout, "SDL offscreen target opened successfully: %dx%d pixels.\n", window_width, window_height);
+    return 1;
+}
+
+/**
+ * @brief Returns the surface drawn into by an offscreen target or the window surface backend.
+ * @return The surface, or NULL when drawing through an accelerated renderer.
+ */
+SDL_Surface *sdlgfx_get_surface(void) {
+    return offscreen_surface ? offscreen_surface : window_surface;
+}
+
+/**
+ * @brief Saves everything drawn so far as a BMP file.
+ *
+ * Reads the pixels like sdlgfx_read_region(); with an accelerated renderer
+ * call it before sdlgfx_flush().
+ *
+ * @param file Path of the BMP file to write.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_save_bmp(const char *file) {
+    if (!sdlgfx_renderer) {
+        fprintf(stderr, "sdlgfx_save_bmp: Renderer not initialized.\n");
+        return 0;
+    }
+
+    SDL_Surface *surface;
+    if (fb.pixels) {
+        tile_resolve();
+        surface = SDL_CreateRGBSurfaceWithFormatFrom(fb.pixels, window_width, window_height, 32,
+                                                     fb.pitch * (int)sizeof(Uint32), SDL_PIXELFORMAT_RGBA8888);
+    } else {
+        surface = SDL_CreateRGBSurfaceWithFormat(0, window_width, window_height, 32, SDL_PIXELFORMAT_RGBA8888);
+        if (surface && !read_pixels(0, 0, window_width, window_height, (Uint32 *)surface->pixels, surface->pitch / (int)sizeof(Uint32))) {
+            SDL_FreeSurface(surface);
+            return 0;
+        }
+    }
+
+    if (!surface) {
+        fprintf(stderr, "sdlgfx_save_bmp: Failed to create surface: %s\n", SDL_GetError());
+        return 0;
+    }
+
+    int result = SDL_SaveBMP(surface, file);
+    if (result != 0) fprintf(stderr, "sdlgfx_save_bmp: SDL_SaveBMP failed: %s\n", SDL_GetError());
+    SDL_FreeSurface(surface);
+    return result == 0;
+}
+
 /**
  * @brief Closes the SDL graphics window.
  */
 void sdlgfx_close(void) {
+    pipe_free();
+    snapshot_free();
+    tile_free();
+    fb_destroy();
+    if (gradient_texture) {
+        SDL_DestroyTexture(gradient_texture);
+        gradient_texture = NULL;
+    }
+    deferred_free();
+    batch_free();
+    polygon_free();
+    texture_ring_free();
+
     if (sdlgfx_texture) {
         SDL_DestroyTexture(sdlgfx_texture);
         sdlgfx_texture = NULL;
     }
 
-    if (sdlgfx_renderer) {
-        SDL_DestroyRenderer(sdlgfx_renderer);
-        sdlgfx_renderer = NULL;
+    sdlfont_free_atlas(); // The atlas texture belongs to the renderer
+
+    if (sdlgfx_renderer) {
+        SDL_DestroyRenderer(sdlgfx_renderer);
+        sdlgfx_renderer = NULL;
+    }
+
+    if (sdlgfx_window) {
+        SDL_DestroyWindow(sdlgfx_window); // Also frees window_surface
+        sdlgfx_window = NULL;
+        window_surface = NULL;
+    }
+
+    if (offscreen_surface) {
+        SDL_FreeSurface(offscreen_surface);
+        offscreen_surface = NULL;
+    }
+
+    SDL_Quit();
+    fprintf(stdout, "SDL graphics window closed.\n");
+}
+
+/**
+ * @brief Updates the texture for dynamic drawing.
+ * @param draw_func Drawing function callback.
+ * @param width Drawing width.
+ * @param height Drawing height.
+ * @param time Time parameter for drawing function.
+ * @param technique Technique parameter for drawing function.
+ * @param update Update flag (1 to update, 0 to skip).
+ */
+void sdlgfx_update_texture(void (*draw_func)(int, int, float, int), int width, int height, float time, int technique, int update) {
+    if (update) {
+        if (fb.pixels) {
+            // The framebuffer is the drawing surface, sdlgfx_texture only presents it
+            sdlgfx_clear();
+            draw_func(width, height, time, technique);
+            return;
+        }
+        deferred_submit(); // Pending commands belong to the previous render target
+        SDL_SetRenderTarget(sdlgfx_renderer, sdlgfx_texture);
+        sdlgfx_clear();
+        draw_func(width, height, time, technique);
+        deferred_submit();
+        SDL_SetRenderTarget(sdlgfx_renderer, NULL);
+    }
+}
+
+/**
+ * @brief Starts drawing frames on a worker thread while the main thread presents.
+ *
+ * The worker calls draw_func for one frame after another, each into the back
+ * frame of a lock-free triple buffer, and sdlgfx_pipeline_draw() shows the
+ * newest finished frame. Computing frame N + 1 thus overlaps uploading and
+ * presenting frame N. draw_func runs on the worker, so it must only write the
+ * pixels it is given and must not call sdlgfx or SDL renderer functions.
+ *
+ * @param draw_func Fills an RGBA8888 frame; pitch is in pixels, time in seconds.
+ * @param technique Initial technique passed to draw_func.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_pipeline_start(void (*draw_func)(Uint32 *pixels, int pitch, int width, int height, float time, int technique),
+                          int technique) {
+    if (!sdlgfx_renderer) {
+        fprintf(stderr, "sdlgfx_pipeline_start: Renderer is not initialized.\n");
+        return 0;
+    }
+    if (!draw_func) return 0;
+    if (pipe_thread) {
+        fprintf(stderr, "sdlgfx_pipeline_start: Pipeline is already running.\n");
+        return 0;
+    }
+
+    pipe_width = window_width;
+    pipe_height = window_height;
+    pipe_pitch = (window_width + 15) & ~15; // Keep every row 64-byte aligned
+    size_t size = (size_t)pipe_pitch * pipe_height * sizeof(Uint32);
+    for (int i = 0; i < 3; i++) {
+        pipe_frames[i] = (Uint32 *)SDL_SIMDAlloc(size);
+        if (!pipe_frames[i]) {
+            fprintf(stderr, "sdlgfx: Failed to allocate pipeline frames.\n");
+            pipe_free();
+            return 0;
+        }
+        memset(pipe_frames[i], 0, size);
     }
+    pipe_texture = SDL_CreateTexture(sdlgfx_renderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING,
+                                     pipe_width, pipe_height);
+    pipe_taken = SDL_CreateSemaphore(1);
+    if (!pipe_texture || !pipe_taken) {
+        fprintf(stderr, "sdlgfx_pipeline_start: %s\n", SDL_GetError());
+        pipe_free();
+        return 0;
+    }
+    SDL_SetTextureBlendMode(pipe_texture, SDL_BLENDMODE_NONE);
 
-    if (sdlgfx_window) {
-        SDL_DestroyWindow(sdlgfx_window);
-        sdlgfx_window = NULL;
+    pipe_func = draw_func;
+    pipe_front = 0;
+    pipe_back = 2;
+    SDL_AtomicSet(&pipe_state, 1);
+    SDL_AtomicSet(&pipe_technique, technique);
+    SDL_AtomicSet(&pipe_quit, 0);
+    pipe_thread = SDL_CreateThread(pipe_worker, "sdlgfx_pipeline", NULL);
+    if (!pipe_thread) {
+        fprintf(stderr, "sdlgfx_pipeline_start: SDL_CreateThread Error: %s\n", SDL_GetError());
+        pipe_free();
+        return 0;
     }
+    return 1;
+}
 
-    SDL_Quit();
-    fprintf(stdout, "SDL graphics window closed.\n");
+/**
+ * @brief Changes the technique passed to the pipeline callback, from the next frame on.
+ * @param technique Technique parameter for the callback.
+ */
+void sdlgfx_pipeline_set_technique(int technique) {
+    SDL_AtomicSet(&pipe_technique, technique);
 }
 
 /**
- * @brief Updates the texture for dynamic drawing.
- * @param draw_func Drawing function callback.
- * @param width Drawing width.
- * @param height Drawing height.
- * @param time Time parameter for drawing function.
- * @param technique Technique parameter for drawing function.
- * @param update Update flag (1 to update, 0 to skip).
+ * @brief Draws the newest finished pipeline frame over the whole window.
+ *
+ * A frame finished since the last call is uploaded first. In framebuffer mode
+ * the frame is copied into the framebuffer, so primitives drawn afterwards
+ * appear on top of it in both backends. Never waits for the worker.
+ *
+ * @return 1 if a frame was drawn, 0 if the pipeline is not running or has no frame yet.
  */
-void sdlgfx_update_texture(void (*draw_func)(int, int, float, int), int width, int height, float time, int technique, int update) {
-    if (update) {
-        SDL_SetRenderTarget(sdlgfx_renderer, sdlgfx_texture);
-        sdlgfx_clear();
-        draw_func(width, height, time, technique);
-        SDL_SetRenderTarget(sdlgfx_renderer, NULL);
+int sdlgfx_pipeline_draw(void) {
+    snapshot_valid = 0;
+    if (!pipe_thread) return 0;
+    int fresh = pipe_take();
+    if (!pipe_shown) return 0;
+
+    const Uint32 *frame = pipe_frames[pipe_front];
+    if (fb.pixels) {
+        tile_resolve();
+        int w = clip_right - clip_left;
+        for (int y = clip_top; y < clip_bottom; y++) {
+            memcpy(fb.pixels + y * fb.pitch + clip_left, frame + y * pipe_pitch + clip_left, w * sizeof(Uint32));
+        }
+        if (w > 0) dirty_add(clip_left, clip_top, clip_right, clip_bottom);
+        return 1;
     }
+    if (fresh) SDL_UpdateTexture(pipe_texture, NULL, frame, pipe_pitch * (int)sizeof(Uint32));
+    deferred_submit(); // Recorded commands were issued first
+    SDL_RenderCopy(sdlgfx_renderer, pipe_texture, NULL, NULL);
+    return 1;
 }
 
 /**
- * @brief Sets the current drawing color.
+ * @brief Stops the pipeline worker after its current frame and frees the frames.
+ */
+void sdlgfx_pipeline_stop(void) {
+    pipe_free();
+}
+
+/**
+ * @brief Sets the current drawing color, fully opaque.
  * @param r Red component (0-255).
  * @param g Green component (0-255).
  * @param b Blue component (0-255).
  */
 void sdlgfx_color(int r, int g, int b) {
+    sdlgfx_color_rgba(r, g, b, 255);
+}
+
+/**
+ * @brief Sets the current drawing color with alpha.
+ * @param r Red component (0-255).
+ * @param g Green component (0-255).
+ * @param b Blue component (0-255).
+ * @param a Alpha component (0-255), 255 is opaque.
+ */
+void sdlgfx_color_rgba(int r, int g, int b, int a) {
     current_color.r = r;
     current_color.g = g;
     current_color.b = b;
-    current_color.a = 255;
+    current_color.a = a;
+    packed_color = fb_pack(r, g, b, a);
+    if (use_deferred) return; // Recorded commands carry their own color
     SDL_SetRenderDrawColor(sdlgfx_renderer, current_color.r, current_color.g, current_color.b, current_color.a);
 }
 
+/**
+ * @brief Sets how primitives are combined with the pixels below them.
+ * @param mode One of the SDLGFX_BLEND_* modes.
+ */
+void sdlgfx_set_blend_mode(int mode) {
+    if (mode < SDLGFX_BLEND_NONE || mode > SDLGFX_BLEND_MUL) {
+        fprintf(stderr, "sdlgfx: Unknown blend mode %d.\n", mode);
+        return;
+    }
+    if (mode == draw_blend) return;
+    deferred_submit(); // Recorded commands keep the mode they were drawn with
+    draw_blend = mode;
+    if (sdlgfx_renderer) SDL_SetRenderDrawBlendMode(sdlgfx_renderer, blend_sdl_mode(mode));
+}
+
 /**
  * @brief Sets the clear color.
  * @param r Red component (0-255).
@@ -224,6 +3673,22 @@ void sdlgfx_clear_color(int r, int g, int b) {
  * @brief Clears the screen with the clear color.
  */
 void sdlgfx_clear(void) {
+    snapshot_valid = 0;
+    if (fb.pixels) {
+        tile_discard(); // Everything binned so far would be painted over
+        Uint32 color = fb_pack(clear_r, clear_g, clear_b, 255);
+        if (use_clip) {
+            // Like SDL_RenderClear, clearing ignores the clip rectangle
+            FbTarget whole = {fb.pixels, fb.pitch, 0, 0, window_width, window_height, {0, 0}};
+            fb_fill_rect(&whole, 0, 0, window_width, window_height, color);
+            dirty_all();
+            return;
+        }
+        TileCmd cmd = {TILE_RECT, color, SDLGFX_BLEND_NONE, {0, 0, window_width, window_height}};
+        fb_draw(&cmd, NULL);
+        return;
+    }
+    deferred_discard(); // Everything recorded so far would be painted over
     SDL_SetRenderDrawColor(sdlgfx_renderer, clear_r, clear_g, clear_b, 255);
     SDL_RenderClear(sdlgfx_renderer);
 }
@@ -234,6 +3699,14 @@ void sdlgfx_clear(void) {
  * @param y Y coordinate.
  */
 void sdlgfx_point(int x, int y) {
+    snapshot_valid = 0;
+    if (!clip_contains(x, y)) return;
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_PLOT, packed_color, draw_blend, {x, y}};
+        fb_draw(&cmd, NULL);
+        return;
+    }
+    if (use_deferred && deferred_record(CMD_POINT, x, y, x, y)) return;
     SDL_RenderDrawPoint(sdlgfx_renderer, x, y);
 }
 
@@ -245,6 +3718,16 @@ void sdlgfx_point(int x, int y) {
  * @param y2 End Y coordinate.
  */
 void sdlgfx_line(int x1, int y1, int x2, int y2) {
+    snapshot_valid = 0;
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_LINE, packed_color, draw_blend, {x1, y1, x2, y2}};
+        fb_draw(&cmd, NULL);
+        return;
+    }
+    // The renderer clips partly visible lines itself, only skip hidden ones
+    LineWalk w;
+    if (!line_clip(&w, x1, y1, x2, y2, clip_left, clip_top, clip_right, clip_bottom)) return;
+    if (use_deferred && deferred_record(CMD_LINE, x1, y1, x2, y2)) return;
     SDL_RenderDrawLine(sdlgfx_renderer, x1, y1, x2, y2);
 }
 
@@ -256,6 +3739,34 @@ void sdlgfx_line(int x1, int y1, int x2, int y2) {
  * @param y2 Bottom-right Y coordinate.
  */
 void sdlgfx_rectangle(int x1, int y1, int x2, int y2) {
+    snapshot_valid = 0;
+    // Same pixels as SDL_RenderDrawRect: the far edges are x2 - 1 and y2 - 1
+    if (!clip_overlaps(x1, y1, x2 - 1, y2 - 1)) return;
+    if (fb.pixels) {
+        // Every pixel is drawn once, so blended corners are not covered twice
+        const TileCmd edges[4] = {
+            {TILE_HLINE, packed_color, draw_blend, {x1, x2 - 1, y1}},
+            {TILE_HLINE, packed_color, draw_blend, {x1, x2 - 1, y2 - 1}},
+            {TILE_LINE, packed_color, draw_blend, {x1, y1 + 1, x1, y2 - 2}},
+            {TILE_LINE, packed_color, draw_blend, {x2 - 1, y1 + 1, x2 - 1, y2 - 2}}
+        };
+        fb_draw(&edges[0], NULL);
+        if (y2 - 1 > y1) fb_draw(&edges[1], NULL);
+        if (y2 - 2 > y1) {
+            fb_draw(&edges[2], NULL);
+            if (x2 - 1 > x1) fb_draw(&edges[3], NULL);
+        }
+        return;
+    }
+    if (use_deferred) {
+        sdlgfx_line(x1, y1, x2 - 1, y1);
+        if (y2 - 1 > y1) sdlgfx_line(x1, y2 - 1, x2 - 1, y2 - 1);
+        if (y2 - 2 > y1) {
+            sdlgfx_line(x1, y1 + 1, x1, y2 - 2);
+            if (x2 - 1 > x1) sdlgfx_line(x2 - 1, y1 + 1, x2 - 1, y2 - 2);
+        }
+        return;
+    }
     SDL_Rect rect = {x1, y1, x2 - x1, y2 - y1};
     SDL_RenderDrawRect(sdlgfx_renderer, &rect);
 }
@@ -268,7 +3779,15 @@ void sdlgfx_rectangle(int x1, int y1, int x2, int y2) {
  * @param y2 Bottom-right Y coordinate.
  */
 void sdlgfx_fill_rectangle(int x1, int y1, int x2, int y2) {
+    snapshot_valid = 0;
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_RECT, packed_color, draw_blend, {x1, y1, x2 - x1, y2 - y1}};
+        fb_draw(&cmd, NULL);
+        return;
+    }
     SDL_Rect rect = {x1, y1, x2 - x1, y2 - y1};
+    if (!clip_rectangle(&rect.x, &rect.y, &rect.w, &rect.h)) return;
+    if (use_deferred && deferred_record(CMD_FILL_RECT, rect.x, rect.y, rect.w, rect.h)) return;
     SDL_RenderFillRect(sdlgfx_renderer, &rect);
 }
 
@@ -279,20 +3798,11 @@ void sdlgfx_fill_rectangle(int x1, int y1, int x2, int y2) {
  * @param radius Circle radius.
  */
 void sdlgfx_circle(int x, int y, int radius) {
-    sdlgfx_color(current_color.r, current_color.g, current_color.b);
-    int num_segments = 100;
-    float angle_step = 2.0 * M_PI / num_segments;
-    float prev_x = x + radius;
-    float prev_y = y;
-
-    for (int i = 1; i <= num_segments; i++) {
-        float angle = i * angle_step;
-        float curr_x = x + radius * cos(angle);
-        float curr_y = y + radius * sin(angle);
-        sdlgfx_line(prev_x, prev_y, curr_x, curr_y);
-        prev_x = curr_x;
-        prev_y = curr_y;
-    }
+    snapshot_valid = 0;
+    if (!clip_overlaps(x - radius, y - radius, x + radius, y + radius)) return;
+    shape_begin();
+    raster_circle(x, y, radius, shape_point);
+    shape_end();
 }
 
 /**
@@ -302,14 +3812,11 @@ void sdlgfx_circle(int x, int y, int radius) {
  * @param radius Circle radius.
  */
 void sdlgfx_fill_circle(int x, int y, int radius) {
-    sdlgfx_color(current_color.r, current_color.g, current_color.b);
-
-    for (int i = 0; i <= radius; i++) {
-        float angle = acos((float)i / radius);
-        int width = radius * sin(angle);
-        sdlgfx_line(x - width, y + i, x + width, y + i);
-        sdlgfx_line(x - width, y - i, x + width, y - i);
-    }
+    snapshot_valid = 0;
+    if (!clip_overlaps(x - radius, y - radius, x + radius, y + radius)) return;
+    shape_begin();
+    raster_fill_circle(x, y, radius, span_add);
+    shape_end();
 }
 
 /**
@@ -322,9 +3829,13 @@ void sdlgfx_fill_circle(int x, int y, int radius) {
  * @param y3 Vertex 3 Y coordinate.
  */
 void sdlgfx_triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
-    sdlgfx_line(x1, y1, x2, y2);
-    sdlgfx_line(x2, y2, x3, y3);
-    sdlgfx_line(x3, y3, x1, y1);
+    snapshot_valid = 0;
+    // One shape, so the vertices shared by two edges are drawn once
+    shape_begin();
+    span_line(x1, y1, x2, y2);
+    span_line(x2, y2, x3, y3);
+    span_line(x3, y3, x1, y1);
+    shape_end();
 }
 
 /**
@@ -337,54 +3848,25 @@ void sdlgfx_triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
  * @param y3 Vertex 3 Y coordinate.
  */
 void sdlgfx_fill_triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
-    // Сортировка вершин по Y
-    if (y1 > y2) {
-        int tmp_x = x1; x1 = x2; x2 = tmp_x;
-        int tmp_y = y1; y1 = y2; y2 = tmp_y;
-    }
-    if (y1 > y3) {
-        int tmp_x = x1; x1 = x3; x3 = tmp_x;
-        int tmp_y = y1; y1 = y3; y3 = tmp_y;
-    }
-    if (y2 > y3) {
-        int tmp_x = x2; x2 = x3; x3 = tmp_x;
-        int tmp_y = y2; y2 = y3; y3 = tmp_y;
-    }
-
-    // Если треугольник вырожденный
-    if (y1 == y3) return;
-
-    // Вычисление наклона
-    float dx_left, dx_right;
-    int x_left, x_right;
-
-    if (y2 - y1 != 0) {
-        float slope1 = (float)(x2 - x1) / (y2 - y1);
-        float slope2 = (float)(x3 - x1) / (y3 - y1);
-
-        for (int y = y1; y <= y2; y++) {
-            x_left = x1 + (y - y1) * slope1;
-            x_right = x1 + (y - y1) * slope2;
-            if (x_left > x_right) {
-                int tmp = x_left; x_left = x_right; x_right = tmp;
-            }
-            sdlgfx_line(x_left, y, x_right, y);
-        }
+    snapshot_valid = 0;
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_TRIANGLE, packed_color, draw_blend, {x1, y1, x2, y2, x3, y3}};
+        fb_draw(&cmd, NULL);
+        return;
     }
 
-    if (y3 - y2 != 0) {
-        float slope1 = (float)(x3 - x2) / (y3 - y2);
-        float slope2 = (float)(x3 - x1) / (y3 - y1);
+    TriEdges e;
+    if (!tri_setup(&e, x1, y1, x2, y2, x3, y3, clip_left, clip_top, clip_right, clip_bottom)) return;
+    const int xy[6] = {x1, y1, x2, y2, x3, y3};
+    if (geometry_draw(xy, NULL, 3, NULL, 0)) return;
 
-        for (int y = y2; y <= y3; y++) {
-            x_left = x2 + (y - y2) * slope1;
-            x_right = x1 + (y - y1) * slope2;
-            if (x_left > x_right) {
-                int tmp = x_left; x_left = x_right; x_right = tmp;
-            }
-            sdlgfx_line(x_left, y, x_right, y);
-        }
+    // Same pixels as the framebuffer rasterizer, one exact span per row
+    shape_begin();
+    for (int y = e.y1; y <= e.y2; y++) {
+        int xl, xr;
+        if (tri_row_span(&e, y, &xl, &xr)) span_add(xl, xr, y);
     }
+    shape_end();
 }
 
 /**
@@ -399,194 +3881,59 @@ void sdlgfx_fill_triangle(int x1, int y1, int x2, int y2, int x3, int y3) {
 void sdlgfx_gradient_triangle(int x1, int y1, int r1, int g1, int b1,
                              int x2, int y2, int r2, int g2, int b2,
                              int x3, int y3, int r3, int g3, int b3) {
-    // Сортировка вершин по Y для упрощения заполнения
-    if (y1 > y2) {
-        int tmp_x = x1; x1 = x2; x2 = tmp_x;
-        int tmp_y = y1; y1 = y2; y2 = tmp_y;
-        int tmp_r = r1; r1 = r2; r2 = tmp_r;
-        int tmp_g = g1; g1 = g2; g2 = tmp_g;
-        int tmp_b = b1; b1 = b2; b2 = tmp_b;
-    }
-    if (y1 > y3) {
-        int tmp_x = x1; x1 = x3; x3 = tmp_x;
-        int tmp_y = y1; y1 = y3; y3 = tmp_y;
-        int tmp_r = r1; r1 = r3; r3 = tmp_r;
-        int tmp_g = g1; g1 = g3; g3 = tmp_g;
-        int tmp_b = b1; b1 = b3; b3 = tmp_b;
-    }
-    if (y2 > y3) {
-        int tmp_x = x2; x2 = x3; x3 = tmp_x;
-        int tmp_y = y2; y2 = y3; y3 = tmp_y;
-        int tmp_r = r2; r2 = r3; r3 = tmp_r;
-        int tmp_g = g2; g2 = g3; g3 = tmp_g;
-        int tmp_b = b2; b2 = b3; b3 = tmp_b;
-    }
-
-    // Если треугольник вырожденный
-    if (y1 == y3) return;
-
-    // Первая половина треугольника (y1 -> y2)
-    if (y2 - y1 != 0) {
-        float slope1 = (float)(x2 - x1) / (y2 - y1);
-        float slope2 = (float)(x3 - x1) / (y3 - y1);
-        for (int y = y1; y <= y2; y++) {
-            int x_left = x1 + (y - y1) * slope1;
-            int x_right = x1 + (y - y1) * slope2;
-            float t1 = (float)(y - y1) / (y2 - y1); // Интерполяция для левой стороны
-            float t2 = (float)(y - y1) / (y3 - y1); // Интерполяция для правой стороны
-            int r_left = r1 + (r2 - r1) * t1;
-            int g_left = g1 + (g2 - g1) * t1;
-            int b_left = b1 + (b2 - b1) * t1;
-            int r_right = r1 + (r3 - r1) * t2;
-            int g_right = g1 + (g3 - g1) * t2;
-            int b_right = b1 + (b3 - b1) * t2;
-
-            if (x_left > x_right) {
-                int tmp_x = x_left; x_left = x_right; x_right = tmp_x;
-                int tmp_r = r_left; r_left = r_right; r_right = tmp_r;
-                int tmp_g = g_left; g_left = g_right; g_right = tmp_g;
-                int tmp_b = b_left; b_left = b_right; b_right = tmp_b;
-            }
-
-            // Интерполяция цвета по горизонтали - SSE2 version
-            if ((x_right - x_left + 1) >= 4) {
-                int num_pixels = x_right - x_left + 1;
-                int num_vector_pixels = num_pixels / 4 * 4;
-                float t_step = 1.0f / (x_right - x_left);
-
-                __m128 left_r = _mm_set1_ps((float)r_left);
-                __m128 left_g = _mm_set1_ps((float)g_left);
-                __m128 left_b = _mm_set1_ps((float)b_left);
-                __m128 diff_r = _mm_set1_ps((float)(r_right - r_left));
-                __m128 diff_g = _mm_set1_ps((float)(g_right - g_left));
-                __m128 diff_b = _mm_set1_ps((float)(b_right - b_left));
-
-                float initial_t = 0.0f;
-                for (int x_vec = 0; x_vec < num_vector_pixels; x_vec += 4) {
-                    __m128 t_vec = _mm_set_ps(initial_t + 3*t_step, initial_t + 2*t_step, initial_t + t_step, initial_t);
-                    __m128 r_vec = _mm_add_ps(left_r, _mm_mul_ps(diff_r, t_vec));
-                    __m128 g_vec = _mm_add_ps(left_g, _mm_mul_ps(diff_g, t_vec));
-                    __m128 b_vec = _mm_add_ps(left_b, _mm_mul_ps(diff_b, t_vec));
-
-                    float r_array[4], g_array[4], b_array[4];
-                    _mm_storeu_ps(r_array, r_vec);
-                    _mm_storeu_ps(g_array, g_vec);
-                    _mm_storeu_ps(b_array, b_vec);
-
-                    for(int i=0; i<4; ++i) {
-                        int r_pixel = (int)r_array[i];
-                        int g_pixel = (int)g_array[i];
-                        int b_pixel = (int)b_array[i];
-                        sdlgfx_color(r_pixel, g_pixel, b_pixel);
-                        sdlgfx_point(x_left + x_vec + i, y);
-                    }
-                    initial_t += 4*t_step;
-                }
-                // Scalar processing for remaining pixels
-                for (int x = x_left + num_vector_pixels; x <= x_right; x++) {
-                    float t = (float)(x - x_left) / (x_right - x_left);
-                    int r = r_left + (r_right - r_left) * t;
-                    int g = g_left + (g_right - g_left) * t;
-                    int b = b_left + (b_right - b_left) * t;
-                    sdlgfx_color(r, g, b);
-                    sdlgfx_point(x, y);
-                }
+    snapshot_valid = 0;
+    const int colors[10] = {r1, g1, b1, r2, g2, b2, r3, g3, b3, current_color.a};
+    TriEdges e;
+    TriColors tc;
 
-
-            } else {
-                // Scalar processing for short lines
-                for (int x = x_left; x <= x_right; x++) {
-                    float t = (float)(x - x_left) / (x_right - x_left);
-                    int r = r_left + (r_right - r_left) * t;
-                    int g = g_left + (g_right - g_left) * t;
-                    int b = b_left + (b_right - b_left) * t;
-                    sdlgfx_color(r, g, b);
-                    sdlgfx_point(x, y);
-                }
-            }
-        }
+    if (fb.pixels) {
+        TileCmd cmd = {TILE_GRADIENT, 0, draw_blend, {x1, y1, x2, y2, x3, y3}};
+        fb_draw(&cmd, colors);
+        return;
     }
 
-    // Вторая половина треугольника (y2 -> y3)
-    if (y3 - y2 != 0) {
-        float slope1 = (float)(x3 - x2) / (y3 - y2);
-        float slope2 = (float)(x3 - x1) / (y3 - y1);
-        for (int y = y2; y <= y3; y++) {
-            int x_left = x2 + (y - y2) * slope1;
-            int x_right = x1 + (y - y1) * slope2;
-            float t1 = (float)(y - y2) / (y3 - y2);
-            float t2 = (float)(y - y1) / (y3 - y1);
-            int r_left = r2 + (r3 - r2) * t1;
-            int g_left = g2 + (g3 - g2) * t1;
-            int b_left = b2 + (b3 - b2) * t1;
-            int r_right = r1 + (r3 - r1) * t2;
-            int g_right = g1 + (g3 - g1) * t2;
-            int b_right = b1 + (b3 - b1) * t2;
-
-            if (x_left > x_right) {
-                int tmp_x = x_left; x_left = x_right; x_right = tmp_x;
-                int tmp_r = r_left; r_left = r_right; r_right = tmp_r;
-                int tmp_g = g_left; g_left = g_right; g_right = tmp_g;
-                int tmp_b = b_left; b_left = b_right; b_right = tmp_b;
-            }
-            // Интерполяция цвета по горизонтали - SSE2 version
-            if ((x_right - x_left + 1) >= 4) {
-                int num_pixels = x_right - x_left + 1;
-                int num_vector_pixels = num_pixels / 4 * 4;
-                float t_step = 1.0f / (x_right - x_left);
-
-                __m128 left_r = _mm_set1_ps((float)r_left);
-                __m128 left_g = _mm_set1_ps((float)g_left);
-                __m128 left_b = _mm_set1_ps((float)b_left);
-                __m128 diff_r = _mm_set1_ps((float)(r_right - r_left));
-                __m128 diff_g = _mm_set1_ps((float)(g_right - g_left));
-                __m128 diff_b = _mm_set1_ps((float)(b_right - b_left));
-
-                float initial_t = 0.0f;
-                for (int x_vec = 0; x_vec < num_vector_pixels; x_vec += 4) {
-                    __m128 t_vec = _mm_set_ps(initial_t + 3*t_step, initial_t + 2*t_step, initial_t + t_step, initial_t);
-                    __m128 r_vec = _mm_add_ps(left_r, _mm_mul_ps(diff_r, t_vec));
-                    __m128 g_vec = _mm_add_ps(left_g, _mm_mul_ps(diff_g, t_vec));
-                    __m128 b_vec = _mm_add_ps(left_b, _mm_mul_ps(diff_b, t_vec));
-
-                    float r_array[4], g_array[4], b_array[4];
-                    _mm_storeu_ps(r_array, r_vec);
-                    _mm_storeu_ps(g_array, g_vec);
-                    _mm_storeu_ps(b_array, b_vec);
-
-                    for(int i=0; i<4; ++i) {
-                        int r_pixel = (int)r_array[i];
-                        int g_pixel = (int)g_array[i];
-                        int b_pixel = (int)b_array[i];
-                        sdlgfx_color(r_pixel, g_pixel, b_pixel);
-                        sdlgfx_point(x_left + x_vec + i, y);
-                    }
-                    initial_t += 4*t_step;
-                }
-                // Scalar processing for remaining pixels
-                for (int x = x_left + num_vector_pixels; x <= x_right; x++) {
-                    float t = (float)(x - x_left) / (x_right - x_left);
-                    int r = r_left + (r_right - r_left) * t;
-                    int g = g_left + (g_right - g_left) * t;
-                    int b = b_left + (b_right - b_left) * t;
-                    sdlgfx_color(r, g, b);
-                    sdlgfx_point(x, y);
-                }
+    if (!tri_setup(&e, x1, y1, x2, y2, x3, y3, clip_left, clip_top, clip_right, clip_bottom)) return;
+    const int xy[6] = {x1, y1, x2, y2, x3, y3};
+    const Uint32 packed[3] = {
+        (Uint32)((r1 & 0xFF) << 16 | (g1 & 0xFF) << 8 | (b1 & 0xFF)),
+        (Uint32)((r2 & 0xFF) << 16 | (g2 & 0xFF) << 8 | (b2 & 0xFF)),
+        (Uint32)((r3 & 0xFF) << 16 | (g3 & 0xFF) << 8 | (b3 & 0xFF))
+    };
+    if (geometry_draw(xy, packed, 3, NULL, 0)) return;
 
+    // Without geometry support, shade the bounding box in a scratch texture,
+    // left neutral where not covered, and draw it with one copy
+    tri_colors_setup(&tc, x1, y1, x2, y2, x3, y3, colors);
 
-            } else {
-                // Scalar processing for short lines
-                for (int x = x_left; x <= x_right; x++) {
-                    float t = (float)(x - x_left) / (x_right - x_left);
-                    int r = r_left + (r_right - r_left) * t;
-                    int g = g_left + (g_right - g_left) * t;
-                    int b = b_left + (b_right - b_left) * t;
-                    sdlgfx_color(r, g, b);
-                    sdlgfx_point(x, y);
-                }
-            }
+    if (!gradient_texture) {
+        gradient_texture = SDL_CreateTexture(sdlgfx_renderer, SDL_PIXELFORMAT_RGBA8888,
+                                             SDL_TEXTUREACCESS_STREAMING, window_width, window_height);
+        if (!gradient_texture) {
+            fprintf(stderr, "sdlgfx: Failed to create gradient texture: %s\n", SDL_GetError());
+            return;
         }
     }
+    // Uncovered texels are transparent, so the copy blends even in SDLGFX_BLEND_NONE.
+    // SDL_BLENDMODE_MOD ignores alpha, so there they are opaque white instead.
+    SDL_BlendMode mode = draw_blend == SDLGFX_BLEND_NONE ? SDL_BLENDMODE_BLEND : blend_sdl_mode(draw_blend);
+    Uint32 uncovered = mode == SDL_BLENDMODE_MOD ? 0xFFFFFFFF : 0;
+    SDL_SetTextureBlendMode(gradient_texture, mode);
+    SDL_SetTextureAlphaMod(gradient_texture, current_color.a);
+
+    SDL_Rect box = {e.x1, e.y1, e.x2 - e.x1 + 1, e.y2 - e.y1 + 1};
+    void *pixels;
+    int pitch;
+    if (SDL_LockTexture(gradient_texture, &box, &pixels, &pitch) != 0) return;
+    pitch /= sizeof(Uint32);
+    for (int row = 0; row < box.h; row++) {
+        Uint32 *texel = (Uint32 *)pixels + row * pitch;
+        for (int col = 0; col < box.w; col++) texel[col] = uncovered;
+    }
+    raster_gradient_triangle(&e, &tc, (Uint32 *)pixels, pitch, box.x, box.y, 255, SDLGFX_BLEND_NONE);
+    SDL_UnlockTexture(gradient_texture);
+
+    deferred_submit(); // Recorded commands were issued first
+    SDL_RenderCopy(sdlgfx_renderer, gradient_texture, &box, &box);
 }
 
 /**
@@ -597,20 +3944,11 @@ void sdlgfx_gradient_triangle(int x1, int y1, int r1, int g1, int b1,
  * @param ry Vertical radius.
  */
 void sdlgfx_ellipse(int x, int y, int rx, int ry) {
-    sdlgfx_color(current_color.r, current_color.g, current_color.b);
-    int num_segments = 100;
-    float angle_step = 2.0 * M_PI / num_segments;
-    float prev_x = x + rx;
-    float prev_y = y;
-
-    for (int i = 1; i <= num_segments; i++) {
-        float angle = i * angle_step;
-        float curr_x = x + rx * cos(angle);
-        float curr_y = y + ry * sin(angle);
-        sdlgfx_line(prev_x, prev_y, curr_x, curr_y);
-        prev_x = curr_x;
-        prev_y = curr_y;
-    }
+    snapshot_valid = 0;
+    if (!clip_overlaps(x - rx, y - ry, x + rx, y + ry)) return;
+    shape_begin();
+    raster_ellipse_walk(x, y, rx, ry, shape_point, NULL);
+    shape_end();
 }
 
 /**
@@ -621,14 +3959,11 @@ void sdlgfx_ellipse(int x, int y, int rx, int ry) {
  * @param ry Vertical radius.
  */
 void sdlgfx_fill_ellipse(int x, int y, int rx, int ry) {
-    sdlgfx_color(current_color.r, current_color.g, current_color.b);
-    float aspect_ratio = (float)ry / rx;
-    for (int i = 0; i <= ry; i++) {
-        float ellipse_y = (float)i / ry;
-        int width = rx * sqrt(1.0 - ellipse_y * ellipse_y);
-        sdlgfx_line(x - width, y + i, x + width, y + i);
-        sdlgfx_line(x - width, y - i, x + width, y - i);
-    }
+    snapshot_valid = 0;
+    if (!clip_overlaps(x - rx, y - ry, x + rx, y + ry)) return;
+    shape_begin();
+    raster_ellipse_walk(x, y, rx, ry, NULL, span_add);
+    shape_end();
 }
 
 /**
@@ -640,30 +3975,197 @@ void sdlgfx_fill_ellipse(int x, int y, int rx, int ry) {
  * @param end_angle End angle in radians.
  */
 void sdlgfx_arc(int x, int y, int radius, float start_angle, float end_angle) {
-    sdlgfx_color(current_color.r, current_color.g, current_color.b);
+    snapshot_valid = 0;
+    if (!clip_overlaps(x - radius, y - radius, x + radius, y + radius)) return;
+    sdlgfx_color_rgba(current_color.r, current_color.g, current_color.b, current_color.a);
     int num_segments = 100;
     float angle_step = (end_angle - start_angle) / num_segments;
     float prev_x = x + radius * cos(start_angle);
     float prev_y = y + radius * sin(start_angle);
 
+    // The segments form one shape, so pixels they share are drawn once
+    shape_begin();
     for (int i = 1; i <= num_segments; i++) {
         float angle = start_angle + i * angle_step;
         float curr_x = x + radius * cos(angle);
         float curr_y = y + radius * sin(angle);
-        sdlgfx_line(prev_x, prev_y, curr_x, curr_y);
+        span_line(prev_x, prev_y, curr_x, curr_y);
         prev_x = curr_x;
         prev_y = curr_y;
     }
+    shape_end();
+}
+
+/**
+ * @brief Draws many points with the current color.
+ * @param xy Coordinates, two ints (x, y) per point.
+ * @param count Number of points.
+ */
+void sdlgfx_points(const int *xy, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_POINTS, xy, NULL, count);
+}
+
+/**
+ * @brief Draws many points, each with its own color.
+ * @param xy Coordinates, two ints (x, y) per point.
+ * @param colors Packed 0xRRGGBB color per point.
+ * @param count Number of points.
+ */
+void sdlgfx_points_colored(const int *xy, const Uint32 *colors, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_POINTS, xy, colors, count);
+}
+
+/**
+ * @brief Draws many separate lines with the current color.
+ * @param xy Coordinates, four ints (x1, y1, x2, y2) per line.
+ * @param count Number of lines.
+ */
+void sdlgfx_lines(const int *xy, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_LINES, xy, NULL, count);
+}
+
+/**
+ * @brief Draws many separate lines, each with its own color.
+ * @param xy Coordinates, four ints (x1, y1, x2, y2) per line.
+ * @param colors Packed 0xRRGGBB color per line.
+ * @param count Number of lines.
+ */
+void sdlgfx_lines_colored(const int *xy, const Uint32 *colors, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_LINES, xy, colors, count);
+}
+
+/**
+ * @brief Draws many filled rectangles with the current color.
+ * @param xy Coordinates, four ints (x1, y1, x2, y2) per rectangle, as in sdlgfx_fill_rectangle().
+ * @param count Number of rectangles.
+ */
+void sdlgfx_fill_rects(const int *xy, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_RECTS, xy, NULL, count);
+}
+
+/**
+ * @brief Draws many filled rectangles, each with its own color.
+ * @param xy Coordinates, four ints (x1, y1, x2, y2) per rectangle, as in sdlgfx_fill_rectangle().
+ * @param colors Packed 0xRRGGBB color per rectangle.
+ * @param count Number of rectangles.
+ */
+void sdlgfx_fill_rects_colored(const int *xy, const Uint32 *colors, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_RECTS, xy, colors, count);
+}
+
+/**
+ * @brief Draws many filled circles with the current color.
+ * @param xyr Three ints (x, y, radius) per circle.
+ * @param count Number of circles.
+ */
+void sdlgfx_fill_circles(const int *xyr, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_CIRCLES, xyr, NULL, count);
+}
+
+/**
+ * @brief Draws many filled circles, each with its own color.
+ * @param xyr Three ints (x, y, radius) per circle.
+ * @param colors Packed 0xRRGGBB color per circle.
+ * @param count Number of circles.
+ */
+void sdlgfx_fill_circles_colored(const int *xyr, const Uint32 *colors, int count) {
+    snapshot_valid = 0;
+    batch_draw(BATCH_CIRCLES, xyr, colors, count);
+}
+
+/**
+ * @brief Draws a triangle mesh with one call.
+ * @param xy Vertex coordinates, two ints (x, y) per vertex.
+ * @param colors Packed 0xRRGGBB color per vertex, interpolated across each triangle, or NULL for the current color.
+ * @param indices Three vertex indices per triangle, or NULL to take the vertices three at a time.
+ * @param count Number of triangles.
+ */
+void sdlgfx_triangles(const int *xy, const Uint32 *colors, const int *indices, int count) {
+    snapshot_valid = 0;
+    if (!xy || count <= 0) return;
+
+    int num_vertices = count * 3;
+    if (indices) {
+        num_vertices = 0;
+        for (int i = 0; i < count * 3; i++) {
+            if (indices[i] < 0) return;
+            if (indices[i] >= num_vertices) num_vertices = indices[i] + 1;
+        }
+    }
+    if (!fb.pixels && geometry_draw(xy, colors, num_vertices, indices, indices ? count * 3 : 0)) return;
+
+    for (int t = 0; t < count; t++) {
+        int v[3];
+        for (int k = 0; k < 3; k++) v[k] = indices ? indices[t * 3 + k] : t * 3 + k;
+        const int *p0 = xy + v[0] * 2, *p1 = xy + v[1] * 2, *p2 = xy + v[2] * 2;
+        if (colors) {
+            Uint32 c0 = colors[v[0]], c1 = colors[v[1]], c2 = colors[v[2]];
+            sdlgfx_gradient_triangle(p0[0], p0[1], c0 >> 16 & 0xFF, c0 >> 8 & 0xFF, c0 & 0xFF,
+                                     p1[0], p1[1], c1 >> 16 & 0xFF, c1 >> 8 & 0xFF, c1 & 0xFF,
+                                     p2[0], p2[1], c2 >> 16 & 0xFF, c2 >> 8 & 0xFF, c2 & 0xFF);
+        } else {
+            sdlgfx_fill_triangle(p0[0], p0[1], p1[0], p1[1], p2[0], p2[1]);
+        }
+    }
+}
+
+
+/**
+ * @brief Draws a closed polygon outline.
+ * @param xy Array of vertices, two ints (x, y) per vertex.
+ * @param count The number of vertices.
+ */
+void sdlgfx_polygon(const int *xy, int count) {
+    snapshot_valid = 0;
+    if (!xy || count <= 0) return;
+    // One shape, so the vertices shared by two edges are drawn once
+    shape_begin();
+    for (int i = 0; i < count; i++) {
+        int j = (i + 1) % count;
+        span_line(xy[2 * i], xy[2 * i + 1], xy[2 * j], xy[2 * j + 1]);
+    }
+    shape_end();
 }
 
+/**
+ * @brief Draws a filled polygon, which may be concave or self-intersecting.
+ * @param xy Array of vertices, two ints (x, y) per vertex.
+ * @param count The number of vertices.
+ * @param rule SDLGFX_EVEN_ODD or SDLGFX_NONZERO.
+ */
+void sdlgfx_fill_polygon(const int *xy, int count, int rule) {
+    snapshot_valid = 0;
+    if (!xy || count < 3) return;
+    shape_begin();
+    raster_polygon(xy, count, rule, clip_left, clip_top, clip_right, clip_bottom);
+    shape_end();
+}
 
 /**
  * @brief Draws text string using built-in font.
+ *
+ * On the renderer the string is drawn from the glyph atlas texture, tinted with
+ * the current color; into the framebuffer it is drawn glyph by glyph.
  * @param x Top-left X coordinate.
  * @param y Top-left Y coordinate.
  * @param cc Text string to draw.
  */
 void sdlgfx_string(int x, int y, const char *cc) {
+    snapshot_valid = 0;
+    if (!cc) return;
+    if (fb.pixels) {
+        sdlfont_draw_string(x, y, cc, NULL);
+        return;
+    }
+    deferred_submit(); // Recorded commands were issued first
+    SDL_SetRenderDrawColor(sdlgfx_renderer, current_color.r, current_color.g, current_color.b, current_color.a);
     sdlfont_draw_string(x, y, cc, sdlgfx_renderer);
 }
 
@@ -671,7 +4173,90 @@ void sdlgfx_string(int x, int y, const char *cc) {
  * @brief Flushes the rendering buffer to display.
  */
 void sdlgfx_flush(void) {
-    SDL_RenderPresent(sdlgfx_renderer);
+    snapshot_valid = 0;
+    deferred_submit();
+    if (fb.pixels) tile_resolve();
+    if (fb.pixels && window_surface) {
+        surface_copy_dirty();
+    } else if (fb.pixels && sdlgfx_texture) {
+        // The texture keeps the previous frame, so only the changed regions are uploaded
+        for (int i = 0; i < dirty_count; i++) {
+            const DirtyRect *d = &dirty_rects[i];
+            SDL_Rect area = {d->x1, d->y1, d->x2 - d->x1, d->y2 - d->y1};
+            SDL_UpdateTexture(sdlgfx_texture, &area, fb.pixels + d->y1 * fb.pitch + d->x1, fb.pitch * (int)sizeof(Uint32));
+        }
+        dirty_count = 0;
+        SDL_RenderCopy(sdlgfx_renderer, sdlgfx_texture, NULL, NULL);
+    }
+    if (present_mode == SDLGFX_PRESENT_PACED) pace_wait();
+    if (window_surface && fb.pixels) {
+        if (surface_rect_count) SDL_UpdateWindowSurfaceRects(sdlgfx_window, surface_rects, surface_rect_count);
+        surface_rect_count = 0;
+    } else if (window_surface) {
+        SDL_UpdateWindowSurface(sdlgfx_window); // The renderer does not track what it changed
+    } else {
+        SDL_RenderPresent(sdlgfx_renderer);
+    }
+    pace_measure();
+}
+
+/**
+ * @brief Selects how sdlgfx_flush() presents frames.
+ *
+ * Before sdlgfx_open() this picks the renderer flags. Afterwards vsync is
+ * switched on the existing renderer, which needs SDL 2.0.18.
+ *
+ * @param mode SDLGFX_PRESENT_VSYNC, SDLGFX_PRESENT_IMMEDIATE or SDLGFX_PRESENT_PACED.
+ * @param rate Target frames per second for SDLGFX_PRESENT_PACED, ignored otherwise.
+ */
+void sdlgfx_set_present_mode(int mode, double rate) {
+    if (mode < SDLGFX_PRESENT_VSYNC || mode > SDLGFX_PRESENT_PACED) {
+        fprintf(stderr, "sdlgfx: Unknown present mode %d.\n", mode);
+        return;
+    }
+    if (mode == SDLGFX_PRESENT_PACED && !(rate > 0.0)) {
+        fprintf(stderr, "sdlgfx: Paced present mode needs a positive rate.\n");
+        return;
+    }
+    if (sdlgfx_window && !window_surface && (mode == SDLGFX_PRESENT_VSYNC) != (present_mode == SDLGFX_PRESENT_VSYNC)) {
+#if SDL_VERSION_ATLEAST(2, 0, 18)
+        if (SDL_RenderSetVSync(sdlgfx_renderer, mode == SDLGFX_PRESENT_VSYNC) != 0) {
+            fprintf(stderr, "sdlgfx: Failed to change vsync: %s\n", SDL_GetError());
+        }
+#else
+        fprintf(stderr, "sdlgfx: Warning: vsync changes take effect at the next sdlgfx_open().\n");
+#endif
+    }
+    present_mode = mode;
+    if (mode == SDLGFX_PRESENT_PACED) present_rate = rate;
+    pace_deadline = 0;
+    sdlgfx_reset_frame_stats();
+}
+
+/**
+ * @brief Reports the frame times measured by sdlgfx_flush().
+ * @param stats Receives the statistics since the last reset.
+ */
+void sdlgfx_get_frame_stats(SdlgfxFrameStats *stats) {
+    double ms = 1000.0 / (double)SDL_GetPerformanceFrequency();
+    stats->frames = (int)pace_frames;
+    stats->late = (int)pace_late;
+    stats->avg_ms = pace_frames ? pace_total * ms / pace_frames : 0.0;
+    stats->min_ms = pace_min * ms;
+    stats->max_ms = pace_max * ms;
+    stats->fps = stats->avg_ms > 0.0 ? 1000.0 / stats->avg_ms : 0.0;
+}
+
+/**
+ * @brief Clears the frame-time statistics.
+ */
+void sdlgfx_reset_frame_stats(void) {
+    pace_last = 0;
+    pace_frames = 0;
+    pace_total = 0;
+    pace_min = 0;
+    pace_max = 0;
+    pace_late = 0;
 }
 
 /**
@@ -750,37 +4335,40 @@ void sdlgfx_move_win_rel(int dx, int dy) {
  * @return Pixel color as 0xRRGGBB integer.
  */
 int GetPix(int x, int y) {
-    if (!sdlgfx_renderer || !sdlgfx_window) {
-        fprintf(stderr, "GetPix: Renderer or window not initialized.\n");
+    if (!sdlgfx_renderer) {
+        fprintf(stderr, "GetPix: Renderer not initialized.\n");
         return 0;
     }
 
     if (x < 0 || x >= window_width || y < 0 || y >= window_height) { return 0; }
 
-    SDL_Surface *temp_surface = SDL_CreateRGBSurfaceWithFormat(0, window_width, window_height, 32, SDL_PIXELFORMAT_ARGB8888);
-
-    if (!temp_surface) {
-        fprintf(stderr, "GetPix: SDL_CreateRGBSurfaceWithFormat failed: %s\n", SDL_GetError());
-        return 0;
+    if (fb.pixels) {
+        tile_resolve();
+        return (int)(fb.pixels[y * fb.pitch + x] >> 8); // RGBA8888 -> 0xRRGGBB
     }
 
-    int result = SDL_RenderReadPixels(sdlgfx_renderer, NULL, SDL_PIXELFORMAT_ARGB8888, temp_surface->pixels, temp_surface->pitch);
+    Uint32 pixel;
+    if (!read_pixels(x, y, 1, 1, &pixel, 1)) return 0;
+    return (int)(pixel >> 8);
+}
 
-    if (result != 0) {
-        fprintf(stderr, "GetPix: SDL_RenderReadPixels failed: %s\n", SDL_GetError());
-        SDL_FreeSurface(temp_surface);
+/**
+ * @brief Copies a rectangle of the frame drawn so far.
+ * @param x, y, w, h The region, which must lie inside the window.
+ * @param buf Receives the pixels as RGBA8888.
+ * @param pitch Row length of buf in pixels.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_read_region(int x, int y, int w, int h, Uint32 *buf, int pitch) {
+    if (!sdlgfx_renderer) {
+        fprintf(stderr, "sdlgfx_read_region: Renderer not initialized.\n");
         return 0;
     }
-
-    Uint32 *pixels = (Uint32 *)temp_surface->pixels;
-    int pixel_offset = (y * temp_surface->pitch / 4) + x;
-    Uint32 pixel_color = pixels[pixel_offset];
-
-    Uint8 r, g, b, a;
-    SDL_GetRGBA(pixel_color, temp_surface->format, &r, &g, &b, &a);
-    SDL_FreeSurface(temp_surface);
-
-    return ((r << 16) | (g << 8) | b);
+    if (x < 0 || y < 0 || w <= 0 || h <= 0 || x + w > window_width || y + h > window_height || pitch < w) {
+        fprintf(stderr, "sdlgfx_read_region: Region outside the window.\n");
+        return 0;
+    }
+    return read_pixels(x, y, w, h, buf, pitch);
 }
 
 /**
@@ -789,7 +4377,41 @@ int GetPix(int x, int y) {
  * @param y Y coordinate.
  */
 void sdlgfx_pixel(int x, int y) {
-    SDL_RenderDrawPoint(sdlgfx_renderer, x, y);
+    sdlgfx_point(x, y);
+}
+
+/**
+ * @brief Draws an 8 pixel wide bitmap glyph with the current color.
+ *
+ * On the framebuffer every row is expanded by the glyph kernel in one step;
+ * on the renderer the set pixels go out as one points call.
+ * @param x Left column.
+ * @param y Top row.
+ * @param rows One byte per row, the most significant bit is the leftmost pixel.
+ * @param height Number of rows.
+ */
+void sdlgfx_glyph(int x, int y, const Uint8 *rows, int height) {
+    snapshot_valid = 0;
+    if (!rows || height <= 0 || !clip_overlaps(x, y, x + 7, y + height - 1)) return;
+    if (fb.pixels) {
+        for (int top = 0; top < height; top += GLYPH_ROWS) {
+            TileCmd cmd = {TILE_GLYPH, packed_color, draw_blend, {x, y + top, 0, 0, 0, 0}};
+            int any = 0;
+            for (int i = 0; i < GLYPH_ROWS && top + i < height; i++) {
+                cmd.v[2 + i / 4] |= (int)((Uint32)rows[top + i] << (8 * (i % 4)));
+                any |= rows[top + i];
+            }
+            if (any) fb_draw(&cmd, NULL);
+        }
+        return;
+    }
+    shape_begin();
+    for (int i = 0; i < height; i++) {
+        for (int j = 0; j < 8; j++) {
+            if (rows[i] & (0x80 >> j)) shape_point(x + j, y + i);
+        }
+    }
+    shape_end();
 }
 
 /**
@@ -802,7 +4424,7 @@ void sdlgfx_pixel(int x, int y) {
  */
 void sdlgfx_pixel_gradient(int x, int y, int r, int g, int b) {
     sdlgfx_color(r, g, b);
-    SDL_RenderDrawPoint(sdlgfx_renderer, x, y);
+    sdlgfx_point(x, y);
 }
 
 /**
@@ -819,6 +4441,7 @@ void sdlgfx_pixel_gradient(int x, int y, int r, int g, int b) {
  * @param pixel_noise_enabled Enable pixel noise effect (1/0).
  */
 void sdlgfx_gradient_vertical_ex(int r1, int g1, int b1, int r2, int g2, int b2, int r3, int g3, int b3, int r4, int g4, int b4, int num_stops, int width, int height, int scanlines_enabled, int noise_enabled, int pixel_noise_enabled) {
+    snapshot_valid = 0;
     int num_actual_stops = num_stops;
 
     if (num_actual_stops < 2 || num_actual_stops > 4) {
@@ -886,11 +4509,11 @@ void sdlgfx_gradient_vertical_ex(int r1, int g1, int b1, int r2, int g2, int b2,
         }
 
         sdlgfx_color(r, g, b);
-        SDL_RenderDrawLine(sdlgfx_renderer, 0, y, width - 1, y);
+        sdlgfx_line(0, y, width - 1, y);
 
         if (scanlines_enabled && (y % 2 == 0)) {
             sdlgfx_color(0, 0, 0);
-            SDL_RenderDrawLine(sdlgfx_renderer, 0, y, width - 1, y);
+            sdlgfx_line(0, y, width - 1, y);
         }
     }
 }
@@ -912,8 +4535,7 @@ SDL_bool sdlgfx_is_char_pixel(const char* text, int text_cols, int char_index_x,
     if (pixel_y_in_char < 0 || pixel_y_in_char >= FONT_HEIGHT) return SDL_FALSE;
 
     char c = text[char_index_x];
-    FontBitmap bitmap;
-    sdlfont_generate_char_bitmap(bitmap, c);
+    const uint8_t *bitmap = sdlfont_glyph(c);
     return ((bitmap[pixel_y_in_char] >> (7 - pixel_x_in_char)) & 0x01) ? SDL_TRUE : SDL_FALSE;
 }
 
@@ -933,35 +4555,62 @@ SDL_Window* sdlgfx_get_window(void) {
 /* ====================================================================== */
 
 /**
- * @brief Locks the streaming texture for direct pixel access.
+ * @brief Locks a region of the streaming texture for direct pixel access.
  *
- * This function must be called before directly manipulating pixels of a streaming texture.
- * It returns a pointer to the pixel data. Make sure to call sdlgfx_unlock_texture_pixels()
- * after pixel manipulation is complete.
+ * Only the region is locked, and in framebuffer mode only the region is
+ * uploaded again by sdlgfx_flush(), so changing a few pixels does not cost a
+ * full window upload. Call sdlgfx_unlock_texture_pixels() when done.
  *
+ * @param x, y, w, h The region, which must lie inside the window.
  * @param pitch Pointer to store the pitch (in pixels) of the texture.
- * @return Pointer to the pixel data of the streaming texture, or NULL on error.
+ * @return Pointer to pixel (x, y), or NULL on error.
  */
-void* sdlgfx_lock_texture_pixels(int *pitch) {
+void* sdlgfx_lock_texture_region(int x, int y, int w, int h, int *pitch) {
     if (!sdlgfx_renderer) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: Renderer is not initialized.\n");
+        fprintf(stderr, "sdlgfx_lock_texture_region: Renderer is not initialized.\n");
+        return NULL;
+    }
+    if (w <= 0 || h <= 0 || x < 0 || y < 0 || x + w > window_width || y + h > window_height) {
+        fprintf(stderr, "sdlgfx_lock_texture_region: Region %d,%d %dx%d is outside the window.\n", x, y, w, h);
         return NULL;
     }
+    if (fb.pixels) {
+        // The framebuffer is already CPU memory, it is uploaded by sdlgfx_flush()
+        if (locked_pixels) {
+            fprintf(stderr, "sdlgfx_lock_texture_region: Texture is already locked. Unlock it first.\n");
+            return NULL;
+        }
+        tile_resolve(); // The caller sees every primitive drawn so far
+        dirty_add(x, y, x + w, y + h);
+        locked_pixels = fb.pixels + y * fb.pitch + x;
+        locked_pitch = fb.pitch * (int)sizeof(Uint32);
+        locked_framebuffer = 1;
+        *pitch = fb.pitch;
+        return locked_pixels;
+    }
     if (!use_streaming_texture) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: Streaming texture is not enabled.\n");
+        fprintf(stderr, "sdlgfx_lock_texture_region: Streaming texture is not enabled.\n");
         return NULL;
     }
     if (!sdlgfx_texture) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: Texture is not created.\n");
+        fprintf(stderr, "sdlgfx_lock_texture_region: Texture is not created.\n");
         return NULL;
     }
     if (locked_pixels) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: Texture is already locked. Unlock it first.\n");
+        fprintf(stderr, "sdlgfx_lock_texture_region: Texture is already locked. Unlock it first.\n");
         return NULL; // Можно изменить на return locked_pixels, если повторный вызов допустим
     }
 
-    if (SDL_LockTexture(sdlgfx_texture, NULL, &locked_pixels, &locked_pitch) != 0) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: SDL_LockTexture Error: %s\n", SDL_GetError());
+    // A full lock goes to the back texture of the ring; a region lock changes
+    // the shown texture in place, the others would miss the rest of the frame
+    SDL_Texture *texture = sdlgfx_texture;
+    if (texture_ring_count > 1 && x == 0 && y == 0 && w == window_width && h == window_height) {
+        texture = texture_ring[texture_back];
+    }
+
+    SDL_Rect area = {x, y, w, h};
+    if (SDL_LockTexture(texture, &area, &locked_pixels, &locked_pitch) != 0) {
+        fprintf(stderr, "sdlgfx_lock_texture_region: SDL_LockTexture Error: %s\n", SDL_GetError());
         locked_pixels = NULL;
         locked_pitch = 0;
         return NULL;
@@ -969,26 +4618,42 @@ void* sdlgfx_lock_texture_pixels(int *pitch) {
 
     // Проверка формата текстуры
     Uint32 format;
-    int access, w, h;
-    if (SDL_QueryTexture(sdlgfx_texture, &format, &access, &w, &h) != 0) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: SDL_QueryTexture Error: %s\n", SDL_GetError());
-        SDL_UnlockTexture(sdlgfx_texture);
+    int access, texture_w, texture_h;
+    if (SDL_QueryTexture(texture, &format, &access, &texture_w, &texture_h) != 0) {
+        fprintf(stderr, "sdlgfx_lock_texture_region: SDL_QueryTexture Error: %s\n", SDL_GetError());
+        SDL_UnlockTexture(texture);
         locked_pixels = NULL;
         locked_pitch = 0;
         return NULL;
     }
     if (format != SDL_PIXELFORMAT_RGBA8888) {
-        fprintf(stderr, "sdlgfx_lock_texture_pixels: Unsupported texture format. Expected RGBA8888.\n");
-        SDL_UnlockTexture(sdlgfx_texture);
+        fprintf(stderr, "sdlgfx_lock_texture_region: Unsupported texture format. Expected RGBA8888.\n");
+        SDL_UnlockTexture(texture);
         locked_pixels = NULL;
         locked_pitch = 0;
         return NULL;
     }
 
+    locked_texture = texture;
+
     *pitch = locked_pitch / sizeof(Uint32); // Pitch в пикселях для RGBA8888
     return locked_pixels;
 }
 
+/**
+ * @brief Locks the streaming texture for direct pixel access.
+ *
+ * This function must be called before directly manipulating pixels of a streaming texture.
+ * It returns a pointer to the pixel data. Make sure to call sdlgfx_unlock_texture_pixels()
+ * after pixel manipulation is complete.
+ *
+ * @param pitch Pointer to store the pitch (in pixels) of the texture.
+ * @return Pointer to the pixel data of the streaming texture, or NULL on error.
+ */
+void* sdlgfx_lock_texture_pixels(int *pitch) {
+    return sdlgfx_lock_texture_region(0, 0, window_width, window_height, pitch);
+}
+
 /**
  * @brief Unlocks the streaming texture, applying pixel changes.
  *
@@ -1000,11 +4665,23 @@ void sdlgfx_unlock_texture_pixels(void) {
         fprintf(stderr, "sdlgfx_unlock_texture_pixels: Texture is not locked.\n");
         return;
     }
-    if (!sdlgfx_texture) {
+    if (locked_framebuffer) {
+        locked_pixels = NULL;
+        locked_pitch = 0;
+        locked_framebuffer = 0;
+        return;
+    }
+    if (!locked_texture) {
         fprintf(stderr, "sdlgfx_unlock_texture_pixels: Texture is not created.\n");
         return;
     }
-    SDL_UnlockTexture(sdlgfx_texture);
+    SDL_UnlockTexture(locked_texture);
+    if (locked_texture != sdlgfx_texture) {
+        // The frame just written is shown from now on
+        sdlgfx_texture = locked_texture;
+        texture_back = (texture_back + 1) % texture_ring_count;
+    }
+    locked_texture = NULL;
     locked_pixels = NULL;
     locked_pitch = 0;
 }
@@ -54,6 +54,139 @@ extern SDL_Texture *sdlgfx_texture; //!< The SDL texture used for rendering.
  */
 void sdlgfx_set_streaming_texture(int enable);
 
+/**
+ * @brief Sets how many streaming textures are used round-robin.
+ *
+ * A full-window sdlgfx_lock_texture_pixels() then writes the texture after the
+ * one last shown, so the CPU fills frame N + 1 while the GPU may still read
+ * frame N and the lock does not wait for it. sdlgfx_unlock_texture_pixels()
+ * makes the written texture the new sdlgfx_texture. Region locks change the
+ * shown texture in place. The framebuffer backend always uses one texture.
+ *
+ * @param count Number of textures, 1 (the default) to 3.
+ */
+void sdlgfx_set_texture_ring(int count);
+
+/**
+ * @brief Returns the texture the next full-window lock will write.
+ *
+ * @return The back texture of the ring, or sdlgfx_texture without a ring.
+ */
+SDL_Texture *sdlgfx_get_back_texture(void);
+
+/**
+ * @brief Enables or disables the CPU framebuffer backend.
+ *
+ * All primitives write pixels into an aligned RGBA8888 buffer in memory, and
+ * sdlgfx_flush() uploads the regions that changed since the last flush (the
+ * bounding boxes of the primitives, merged into at most 16 rectangles). This
+ * replaces one renderer call per pixel, line or span with plain memory writes
+ * and behaves the same on software renderers. Can be toggled before or after
+ * sdlgfx_open(); sdlgfx_lock_texture_pixels() returns the framebuffer while it is active.
+ *
+ * @param enable Non-zero to draw into the framebuffer, zero to draw through the SDL renderer.
+ */
+void sdlgfx_set_framebuffer(int enable);
+
+/**
+ * @brief Draws into the window surface instead of through an accelerated renderer.
+ *
+ * For machines without a GPU. sdlgfx_open() then creates a software renderer
+ * on the surface from SDL_GetWindowSurface(), so primitives write the native
+ * pixel format and no texture is uploaded or copied. sdlgfx_flush() presents
+ * with SDL_UpdateWindowSurface(); with the framebuffer backend it converts
+ * only the changed regions into the surface and presents just those with
+ * SDL_UpdateWindowSurfaceRects(). Takes effect at the next sdlgfx_open(), vsync
+ * is not available.
+ *
+ * @param enable Non-zero to draw into the window surface, zero for the SDL renderer.
+ */
+void sdlgfx_set_window_surface(int enable);
+
+/**
+ * @brief Enables or disables deferred drawing.
+ *
+ * While enabled, points, lines, rectangles and color changes are appended to a
+ * per-frame command buffer instead of going to the renderer. sdlgfx_flush()
+ * merges runs of the same color into single SDL_RenderDrawPoints,
+ * SDL_RenderFillRects and SDL_RenderDrawLines calls. Has no effect while the
+ * framebuffer backend is active.
+ *
+ * @param enable Non-zero to record draw commands, zero to draw immediately.
+ */
+void sdlgfx_set_deferred(int enable);
+
+/**
+ * @brief Draws all recorded commands without presenting the frame.
+ *
+ * Call this before issuing SDL renderer calls directly while deferred drawing is enabled.
+ */
+void sdlgfx_submit(void);
+
+/**
+ * @brief Sets how many threads rasterize the CPU framebuffer.
+ *
+ * With more than one thread, every framebuffer primitive is binned into the
+ * 64x64 screen tiles it touches. sdlgfx_flush() (or GetPix and
+ * sdlgfx_lock_texture_pixels, which need finished pixels) then renders the
+ * tiles in parallel: each tile replays its own primitives in drawing order and
+ * no two threads ever write the same pixel. The result is identical to
+ * drawing on one thread. Has no effect on the SDL renderer backend.
+ *
+ * @param count Number of threads including the caller; 0 uses one per CPU core,
+ *              1 (the default) draws immediately on the calling thread.
+ */
+void sdlgfx_set_threads(int count);
+
+#define SDLGFX_SIMD_SCALAR 0 //!< Kernel set: portable C, used on non-x86 CPUs.
+#define SDLGFX_SIMD_SSE2   1 //!< Kernel set: SSE2, 4 pixels per operation.
+#define SDLGFX_SIMD_SSE41  2 //!< Kernel set: SSE4.1, 32-bit multiply, min, max and blendv.
+#define SDLGFX_SIMD_AVX2   3 //!< Kernel set: AVX2, 8 pixels per operation.
+
+/**
+ * @brief Caps the instruction set of the CPU framebuffer kernels.
+ *
+ * sdlgfx_open() checks the CPU once and picks the best kernels for span
+ * fills, gradients, glyphs and blending, up to this level (SDLGFX_SIMD_AVX2
+ * by default). Every level draws identical pixels, so a lower cap is only
+ * useful for testing and measuring. Takes effect at the next sdlgfx_open().
+ *
+ * @param level One of the SDLGFX_SIMD_* levels.
+ */
+void sdlgfx_set_simd(int level);
+
+/**
+ * @brief Returns the SDLGFX_SIMD_* level of the active kernels.
+ */
+int sdlgfx_get_simd(void);
+
+/**
+ * @brief Returns the name of a SDLGFX_SIMD_* level ("scalar", "sse2", "sse4.1" or "avx2").
+ */
+const char *sdlgfx_simd_name(int level);
+
+/**
+ * @brief Limits all drawing to a rectangle of the window.
+ *
+ * Every primitive is clipped before it is rasterized or handed to the SDL
+ * renderer: lines are cut to their visible pixels, circles, ellipses, arcs and
+ * triangles entirely outside the rectangle are skipped from their bounding
+ * box, and filled shapes only produce the visible part of each span. Drawing
+ * thus costs in proportion to what is visible. The rectangle is intersected
+ * with the window; sdlgfx_clear() still clears the whole window.
+ *
+ * @param x Left edge of the rectangle.
+ * @param y Top edge of the rectangle.
+ * @param w Width of the rectangle; 0 or less clips everything away.
+ * @param h Height of the rectangle; 0 or less clips everything away.
+ */
+void sdlgfx_set_clip(int x, int y, int w, int h);
+
+/**
+ * @brief Removes the clip rectangle set by sdlgfx_set_clip().
+ */
+void sdlgfx_reset_clip(void);
+
 /**
  * @brief Opens a new SDL graphics window.
  *
@@ -68,6 +201,40 @@ void sdlgfx_set_streaming_texture(int enable);
  */
 void sdlgfx_open(int width, int height, const char *title, int initial_x, int initial_y);
 
+/**
+ * @brief Opens a headless drawing target instead of a window.
+ *
+ * Draws with the SDL software renderer into an RGBA8888 memory surface, so no
+ * video device or display is needed (batch jobs, CI containers). Every
+ * primitive, text and the framebuffer backend work as with a window;
+ * sdlgfx_flush() completes the frame in the surface. Close it with sdlgfx_close().
+ *
+ * @param width Width of the target in pixels.
+ * @param height Height of the target in pixels.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_open_offscreen(int width, int height);
+
+/**
+ * @brief Returns the surface of an offscreen target or of the window surface backend.
+ *
+ * Holds the finished frame after sdlgfx_flush().
+ *
+ * @return The surface, or NULL when drawing through an accelerated renderer.
+ */
+SDL_Surface *sdlgfx_get_surface(void);
+
+/**
+ * @brief Saves everything drawn so far as a BMP file.
+ *
+ * Works offscreen and with a window; on a window without the framebuffer
+ * backend call it before sdlgfx_flush(), which discards the back buffer.
+ *
+ * @param file Path of the BMP file to write.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_save_bmp(const char *file);
+
 /**
  * @brief Closes the SDL graphics window and cleans up resources.
  *
@@ -78,7 +245,7 @@ void sdlgfx_close(void);
 /**
  * @brief Sets the current drawing color.
  *
- * Subsequent drawing operations will use this color.
+ * Subsequent drawing operations will use this color, fully opaque.
  *
  * @param r Red color component (0-255).
  * @param g Green color component (0-255).
@@ -86,6 +253,35 @@ void sdlgfx_close(void);
  */
 void sdlgfx_color(int r, int g, int b);
 
+/**
+ * @brief Sets the current drawing color with an alpha value.
+ *
+ * The alpha is applied by the blend mode set with sdlgfx_set_blend_mode().
+ * Shaded and per-vertex colored primitives take the alpha of the current color.
+ *
+ * @param r Red color component (0-255).
+ * @param g Green color component (0-255).
+ * @param b Blue color component (0-255).
+ * @param a Alpha component (0 transparent - 255 opaque).
+ */
+void sdlgfx_color_rgba(int r, int g, int b, int a);
+
+#define SDLGFX_BLEND_NONE  0 //!< Blend mode: write the color as is, ignoring alpha.
+#define SDLGFX_BLEND_ALPHA 1 //!< Blend mode: source over destination (the default).
+#define SDLGFX_BLEND_ADD   2 //!< Blend mode: add the source, weighted by alpha, to the destination.
+#define SDLGFX_BLEND_MUL   3 //!< Blend mode: multiply the destination by the source, weighted by alpha.
+
+/**
+ * @brief Sets how all primitives combine their color with the pixels below.
+ *
+ * On the CPU framebuffer the blending runs in the SIMD kernels picked by
+ * sdlgfx_open(), and fully opaque colors are simply written.
+ * sdlgfx_clear() is never blended.
+ *
+ * @param mode SDLGFX_BLEND_NONE, SDLGFX_BLEND_ALPHA, SDLGFX_BLEND_ADD or SDLGFX_BLEND_MUL.
+ */
+void sdlgfx_set_blend_mode(int mode);
+
 /**
  * @brief Sets the clear color for the drawing surface.
  *
@@ -173,6 +369,11 @@ void sdlgfx_triangle(int x1, int y1, int x2, int y2, int x3, int y3);
 /**
  * @brief Draws a filled triangle.
  *
+ * A pixel is filled when its center lies inside the triangle. Centers exactly
+ * on an edge follow the top-left rule, so triangles sharing an edge never draw
+ * the same pixel twice and a mesh has no gaps or overdraw. With SDL 2.0.18 or
+ * newer the renderer path uses SDL_RenderGeometry and the renderer's own rule.
+ *
  * @param x1 The x-coordinate of the first vertex.
  * @param y1 The y-coordinate of the first vertex.
  * @param x2 The x-coordinate of the second vertex.
@@ -184,6 +385,13 @@ void sdlgfx_fill_triangle(int x1, int y1, int x2, int y2, int x3, int y3);
 
 /**
  * @brief Draws a filled triangle with a gradient fill between three vertex colors.
+ *
+ * With SDL 2.0.18 or newer the renderer draws it with SDL_RenderGeometry.
+ * Otherwise, and in framebuffer mode, it covers the same pixels as
+ * sdlgfx_fill_triangle(): the colors are interpolated in fixed point and written
+ * as whole spans, into the framebuffer when it is active, otherwise into a
+ * streaming texture drawn with a single copy.
+ *
  * @param x1, y1 The coordinates of the first vertex.
  * @param r1, g1, b1 The color of the first vertex (0-255).
  * @param x2, y2 The coordinates of the second vertex.
@@ -226,6 +434,127 @@ void sdlgfx_fill_ellipse(int x, int y, int rx, int ry);
  */
 void sdlgfx_arc(int x, int y, int radius, float start_angle, float end_angle);
 
+/**
+ * @brief Draws many points with one call.
+ *
+ * The whole array costs one renderer call instead of one per point.
+ *
+ * @param xy Array of coordinates, two ints (x, y) per point.
+ * @param count The number of points.
+ */
+void sdlgfx_points(const int *xy, int count);
+
+/**
+ * @brief Draws many points with one call, each with its own color.
+ *
+ * Points are grouped by color and every group costs one renderer call.
+ * Within a group the original order is kept, but overlapping points of
+ * different colors may be painted in a different order.
+ *
+ * @param xy Array of coordinates, two ints (x, y) per point.
+ * @param colors Array of packed 0xRRGGBB colors, one per point.
+ * @param count The number of points.
+ */
+void sdlgfx_points_colored(const int *xy, const Uint32 *colors, int count);
+
+/**
+ * @brief Draws many separate lines with one call.
+ *
+ * @param xy Array of coordinates, four ints (x1, y1, x2, y2) per line.
+ * @param count The number of lines.
+ */
+void sdlgfx_lines(const int *xy, int count);
+
+/**
+ * @brief Draws many separate lines with one call, each with its own color.
+ *
+ * Grouped by color like sdlgfx_points_colored().
+ *
+ * @param xy Array of coordinates, four ints (x1, y1, x2, y2) per line.
+ * @param colors Array of packed 0xRRGGBB colors, one per line.
+ * @param count The number of lines.
+ */
+void sdlgfx_lines_colored(const int *xy, const Uint32 *colors, int count);
+
+/**
+ * @brief Draws many filled rectangles with one call.
+ *
+ * @param xy Array of coordinates, four ints (x1, y1, x2, y2) per rectangle.
+ * @param count The number of rectangles.
+ */
+void sdlgfx_fill_rects(const int *xy, int count);
+
+/**
+ * @brief Draws many filled rectangles with one call, each with its own color.
+ *
+ * Grouped by color like sdlgfx_points_colored().
+ *
+ * @param xy Array of coordinates, four ints (x1, y1, x2, y2) per rectangle.
+ * @param colors Array of packed 0xRRGGBB colors, one per rectangle.
+ * @param count The number of rectangles.
+ */
+void sdlgfx_fill_rects_colored(const int *xy, const Uint32 *colors, int count);
+
+/**
+ * @brief Draws many filled circles with one call.
+ *
+ * @param xyr Array of circles, three ints (x, y, radius) per circle.
+ * @param count The number of circles.
+ */
+void sdlgfx_fill_circles(const int *xyr, int count);
+
+/**
+ * @brief Draws many filled circles with one call, each with its own color.
+ *
+ * Grouped by color like sdlgfx_points_colored().
+ *
+ * @param xyr Array of circles, three ints (x, y, radius) per circle.
+ * @param colors Array of packed 0xRRGGBB colors, one per circle.
+ * @param count The number of circles.
+ */
+void sdlgfx_fill_circles_colored(const int *xyr, const Uint32 *colors, int count);
+
+/**
+ * @brief Draws a triangle mesh with one call.
+ *
+ * With SDL 2.0.18 or newer the whole mesh goes to SDL_RenderGeometry and the
+ * renderer interpolates the vertex colors. Otherwise, and in framebuffer mode,
+ * each triangle is drawn like sdlgfx_gradient_triangle() or sdlgfx_fill_triangle().
+ *
+ * @param xy Array of vertex coordinates, two ints (x, y) per vertex.
+ * @param colors Array of packed 0xRRGGBB colors, one per vertex, or NULL to use the current color.
+ * @param indices Array of vertex indices, three per triangle, or NULL to take the vertices three at a time.
+ * @param count The number of triangles.
+ */
+void sdlgfx_triangles(const int *xy, const Uint32 *colors, const int *indices, int count);
+
+/**
+ * @brief Draws a closed polygon outline, one line per edge.
+ *
+ * @param xy Array of vertices, two ints (x, y) per vertex.
+ * @param count The number of vertices; the last vertex connects back to the first.
+ */
+void sdlgfx_polygon(const int *xy, int count);
+
+#define SDLGFX_EVEN_ODD 0 //!< Fill rule: a point is inside if a ray from it crosses an odd number of edges.
+#define SDLGFX_NONZERO  1 //!< Fill rule: a point is inside if the edges wind around it a nonzero number of times.
+
+/**
+ * @brief Draws a filled polygon with a scanline fill.
+ *
+ * Works for convex, concave and self-intersecting polygons without
+ * triangulation. The edges go into a table sorted by their first row and an
+ * active edge list walks down the rows, so the whole polygon costs one pass
+ * and its spans are drawn in one batch. Pixels are sampled at their centers
+ * like sdlgfx_fill_triangle(), so a triangle gives the same pixels either way
+ * and polygons sharing an edge do not overlap.
+ *
+ * @param xy Array of vertices, two ints (x, y) per vertex.
+ * @param count The number of vertices.
+ * @param rule SDLGFX_EVEN_ODD or SDLGFX_NONZERO; they differ only where the outline crosses itself.
+ */
+void sdlgfx_fill_polygon(const int *xy, int count, int rule);
+
 
 /**
  * @brief Draws a text string using the built-in font.
@@ -238,9 +567,56 @@ void sdlgfx_string(int x, int y, const char *cc);
 
 /**
  * @brief Flushes the renderer, making the drawn content visible.
+ *
+ * Presents according to the mode set with sdlgfx_set_present_mode() and
+ * records the time since the previous flush for sdlgfx_get_frame_stats().
  */
 void sdlgfx_flush(void);
 
+#define SDLGFX_PRESENT_VSYNC     0 //!< Present mode: wait for the display refresh (the default).
+#define SDLGFX_PRESENT_IMMEDIATE 1 //!< Present mode: present as fast as frames are drawn.
+#define SDLGFX_PRESENT_PACED     2 //!< Present mode: no vsync, sdlgfx_flush() holds frames to a target rate.
+
+/**
+ * @brief Frame-time statistics measured between consecutive sdlgfx_flush() calls.
+ */
+typedef struct {
+    int frames;    //!< Number of measured frame intervals.
+    int late;      //!< Paced frames that missed their deadline.
+    double avg_ms; //!< Average frame time in milliseconds.
+    double min_ms; //!< Shortest frame time in milliseconds.
+    double max_ms; //!< Longest frame time in milliseconds.
+    double fps;    //!< Frames per second from the average frame time.
+} SdlgfxFrameStats;
+
+/**
+ * @brief Selects how sdlgfx_flush() presents frames.
+ *
+ * SDLGFX_PRESENT_IMMEDIATE turns vsync off to measure raw throughput.
+ * SDLGFX_PRESENT_PACED also turns it off and waits in sdlgfx_flush() until the
+ * next frame is due, timed with SDL_GetPerformanceCounter(): it sleeps until
+ * about 2 ms before the deadline and spins for the rest, so frames are spaced
+ * far more evenly than with SDL_Delay() alone. Can be called before or after
+ * sdlgfx_open(); switching vsync on an open window needs SDL 2.0.18.
+ * Resets the frame-time statistics.
+ *
+ * @param mode SDLGFX_PRESENT_VSYNC, SDLGFX_PRESENT_IMMEDIATE or SDLGFX_PRESENT_PACED.
+ * @param rate Target frames per second for SDLGFX_PRESENT_PACED, ignored otherwise.
+ */
+void sdlgfx_set_present_mode(int mode, double rate);
+
+/**
+ * @brief Returns the frame times measured since the last reset.
+ *
+ * @param stats Receives the statistics.
+ */
+void sdlgfx_get_frame_stats(SdlgfxFrameStats *stats);
+
+/**
+ * @brief Clears the frame-time statistics, for example after loading or between benchmarks.
+ */
+void sdlgfx_reset_frame_stats(void);
+
 /**
  * @brief Waits for a key press or window close event.
  *
@@ -288,12 +664,28 @@ void sdlgfx_move_win_rel(int dx, int dy);
 /**
  * @brief Retrieves the color of a pixel at the given coordinates.
  *
+ * Reads the CPU framebuffer or the software renderer's surface directly. With
+ * an accelerated renderer the frame is read back once into a snapshot that
+ * serves every query until the next draw call or sdlgfx_flush(). After
+ * drawing with SDL renderer functions directly, call sdlgfx_submit() so the
+ * snapshot is taken again.
+ *
  * @param x The x-coordinate of the pixel.
  * @param y The y-coordinate of the pixel.
  * @return The pixel color as an integer (0xRRGGBB).
  */
 int GetPix(int x, int y);
 
+/**
+ * @brief Copies a rectangle of the frame drawn so far, read like GetPix().
+ *
+ * @param x, y, w, h The region, which must lie inside the window.
+ * @param buf Receives the pixels as RGBA8888.
+ * @param pitch Row length of buf in pixels, at least w.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_read_region(int x, int y, int w, int h, Uint32 *buf, int pitch);
+
 /**
  * @brief Draws a single pixel using the current color.
  *
@@ -302,6 +694,18 @@ int GetPix(int x, int y);
  */
 void sdlgfx_pixel(int x, int y);
 
+/**
+ * @brief Draws an 8 pixel wide bitmap glyph with the current color.
+ *
+ * Used by the font code to draw a whole character at once.
+ *
+ * @param x Left column.
+ * @param y Top row.
+ * @param rows One byte per row, the most significant bit is the leftmost pixel.
+ * @param height Number of rows.
+ */
+void sdlgfx_glyph(int x, int y, const Uint8 *rows, int height);
+
 /**
  * @brief Updates the texture with a custom drawing function.
  *
@@ -314,6 +718,43 @@ void sdlgfx_pixel(int x, int y);
  */
 void sdlgfx_update_texture(void (*draw_func)(int, int, float, int), int width, int height, float time, int technique, int update);
 
+/**
+ * @brief Starts computing frames on a worker thread while the main thread presents.
+ *
+ * The worker calls draw_func for one frame after another, each into the back
+ * frame of a lock-free triple buffer of RGBA8888 frames, running one frame
+ * ahead of sdlgfx_pipeline_draw(). draw_func runs on the worker: it must only
+ * write the given pixels and must not call sdlgfx or SDL renderer functions.
+ *
+ * @param draw_func Fills a window-sized frame; pitch is in pixels, time in seconds.
+ * @param technique Initial technique parameter passed to draw_func.
+ * @return 1 on success, 0 on error.
+ */
+int sdlgfx_pipeline_start(void (*draw_func)(Uint32 *pixels, int pitch, int width, int height, float time, int technique),
+                          int technique);
+
+/**
+ * @brief Changes the technique passed to the pipeline callback from its next frame on.
+ *
+ * @param technique Technique parameter for the callback.
+ */
+void sdlgfx_pipeline_set_technique(int technique);
+
+/**
+ * @brief Draws the newest finished pipeline frame over the whole window.
+ *
+ * Uploads the frame if it is new, and never waits for the worker. In
+ * framebuffer mode the frame is copied into the framebuffer instead.
+ *
+ * @return 1 if a frame was drawn, 0 if the pipeline is not running or has no frame yet.
+ */
+int sdlgfx_pipeline_draw(void);
+
+/**
+ * @brief Stops the pipeline worker after its current frame and frees the frames.
+ */
+void sdlgfx_pipeline_stop(void);
+
 /**
  * @brief Draws a pixel with a specified gradient color.
  *
@@ -373,11 +814,26 @@ SDL_Window* sdlgfx_get_window(void);
 /**
  * @brief Locks the streaming texture for direct pixel access.
  *
- * @param pitch Pointer to store the pitch (in bytes) of the texture.
+ * In framebuffer mode the whole window is uploaded again by the next sdlgfx_flush().
+ *
+ * @param pitch Pointer to store the pitch (in pixels) of the texture.
  * @return Pointer to the pixel data of the streaming texture, or NULL on error.
  */
 void* sdlgfx_lock_texture_pixels(int *pitch);
 
+/**
+ * @brief Locks only a region of the streaming texture for direct pixel access.
+ *
+ * Use it instead of sdlgfx_lock_texture_pixels() when a few pixels change: only
+ * the region is locked, and in framebuffer mode only the region is uploaded by
+ * the next sdlgfx_flush(). Unlock with sdlgfx_unlock_texture_pixels().
+ *
+ * @param x, y, w, h The region, which must lie inside the window.
+ * @param pitch Pointer to store the pitch (in pixels) of the texture.
+ * @return Pointer to pixel (x, y), or NULL on error.
+ */
+void* sdlgfx_lock_texture_region(int x, int y, int w, int h, int *pitch);
+
 /**
  * @brief Unlocks the streaming texture, applying pixel changes.
  */
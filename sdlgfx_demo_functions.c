@@ -66,6 +66,7 @@ void demo_points(void);
 void demo_text(void);
 void demo_ellipses(void);
 void demo_arcs(void);
+void demo_polygons(void);
 //void demo_gradient_triangles(void);
 void demo_pixel_effects(void);
 void demo_text_collision(void);
@@ -130,6 +131,9 @@ void demo_triangles() {
                                   150 + sin(SDL_GetTicks() * 0.002) * 50,
                                   0, 0, 0, 0, 0, 0, 2, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0, 0);
 
+        int xy[5 * 6];
+        Uint32 colors[5 * 3];
+        int num_filled = 0;
         for (int i = 0; i < 5; i++) {
             update_position(&triangles[i], SCREEN_WIDTH, SCREEN_HEIGHT);
             float s = sin(triangles[i].rotation);
@@ -142,27 +146,30 @@ void demo_triangles() {
             int x3 = triangles[i].x + (int)(size * cos(triangles[i].rotation + 4*M_PI/3));
             int y3 = triangles[i].y + (int)(size * sin(triangles[i].rotation + 4*M_PI/3));
 
-            if (i % 3 == 0) {
-                sdlgfx_color(triangles[i].r, triangles[i].g, triangles[i].b);
-                sdlgfx_fill_triangle(x1, y1, x2, y2, x3, y3);
-            } else if (i % 3 == 1) {
-                for (int y = (y1 < y2 ? y1 : y2); y <= (y3 > y2 ? y3 : y2); y++) {
-                    int r = triangles[i].r + (y - y1) * 20 % 255;
-                    int g = triangles[i].g + (y - y1) * 30 % 255;
-                    int b = triangles[i].b + (y - y1) * 40 % 255;
-                    sdlgfx_color(r, g, b);
-                    sdlgfx_line(x1 + (y-y1)*0.5, y, x2 - (y-y2)*0.5, y);
-                }
-            } else {
+            if (i % 3 == 2) {
                 sdlgfx_color(triangles[i].r, triangles[i].g, triangles[i].b);
                 sdlgfx_triangle(x1, y1, x2, y2, x3, y3);
+                continue;
             }
+
+            // Заливка и градиент идут в один меш
+            Uint32 base = (triangles[i].r << 16) | (triangles[i].g << 8) | triangles[i].b;
+            int *v = xy + num_filled * 6;
+            v[0] = x1; v[1] = y1; v[2] = x2; v[3] = y2; v[4] = x3; v[5] = y3;
+            if (i % 3 == 0) {
+                colors[num_filled * 3] = colors[num_filled * 3 + 1] = colors[num_filled * 3 + 2] = base;
+            } else {
+                colors[num_filled * 3] = base;
+                colors[num_filled * 3 + 1] = base ^ 0xFF8000;
+                colors[num_filled * 3 + 2] = base ^ 0x0080FF;
+            }
+            num_filled++;
         }
+        sdlgfx_triangles(xy, colors, NULL, num_filled); // Один вызов SDL_RenderGeometry на кадр
 
         draw_info_panel("sdlgfx_triangle", "Rotating Gradient Triangles",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -192,23 +199,28 @@ void demo_circles() {
                                   150 + sin(SDL_GetTicks() * 0.002) * 50,
                                   0, 0, 0, 0, 0, 0, 2, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0, 0);
 
+        int filled[5 * 3];
+        Uint32 filled_colors[5];
+        int num_filled = 0;
         for (int i = 0; i < 5; i++) {
             update_position(&circles[i], SCREEN_WIDTH, SCREEN_HEIGHT);
             int radius = circles[i].size + (int)(sin(circles[i].rotation) * 10);
             
             if (i % 2 == 0) {
-                sdlgfx_color(circles[i].r, circles[i].g, circles[i].b);
-                sdlgfx_fill_circle(circles[i].x, circles[i].y, radius);
+                filled[num_filled * 3] = circles[i].x;
+                filled[num_filled * 3 + 1] = circles[i].y;
+                filled[num_filled * 3 + 2] = radius;
+                filled_colors[num_filled++] = (circles[i].r << 16) | (circles[i].g << 8) | circles[i].b;
             } else {
                 sdlgfx_color(circles[i].r, circles[i].g, circles[i].b);
                 sdlgfx_circle(circles[i].x, circles[i].y, radius);
             }
         }
+        sdlgfx_fill_circles_colored(filled, filled_colors, num_filled);
 
         draw_info_panel("sdlgfx_circle", "Pulsating Moving Circles",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -258,7 +270,6 @@ void demo_rectangles() {
         draw_info_panel("sdlgfx_rectangle", "Rotating Moving Rectangles",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -297,7 +308,6 @@ void demo_lines() {
         draw_info_panel("sdlgfx_line", "Rotating Rainbow Lines from Center",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -358,7 +368,6 @@ void demo_gradients() {
                        "Gradient with pixel noise effect",
                        DEMO_DURATION - elapsed);
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -385,7 +394,6 @@ void demo_window_movement() {
         draw_info_panel("SDL_SetWindowPosition", "Window Moving Smoothly",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
     SDL_SetWindowPosition(window, orig_x, orig_y);
@@ -416,16 +424,19 @@ void demo_points() {
                                   150 + sin(SDL_GetTicks() * 0.002) * 50,
                                   0, 0, 0, 0, 0, 0, 2, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0, 0);
 
+        int xy[500 * 2];
+        Uint32 colors[500];
         for (int i = 0; i < 500; i++) {
             update_position(&points[i], SCREEN_WIDTH, SCREEN_HEIGHT);
-            sdlgfx_color(points[i].r, points[i].g, points[i].b);
-            sdlgfx_point(points[i].x, points[i].y);
+            xy[i * 2] = points[i].x;
+            xy[i * 2 + 1] = points[i].y;
+            colors[i] = (points[i].r << 16) | (points[i].g << 8) | points[i].b;
         }
+        sdlgfx_points_colored(xy, colors, 500); // Все точки одним вызовом
 
         draw_info_panel("sdlgfx_point", "Moving Random Colored Points",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -465,7 +476,6 @@ void demo_text() {
         draw_info_panel("sdlgfx_string", "Animated Colored Text",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -512,7 +522,6 @@ void demo_ellipses() {
         draw_info_panel("sdlgfx_ellipse", "Pulsating Moving Ellipses",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -547,7 +556,56 @@ void demo_arcs() {
         draw_info_panel("sdlgfx_arc", "Rotating Pulsating Arcs",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
+        handle_input(&running);
+    }
+}
+
+void demo_polygons() {
+    sdlgfx_clear();
+    MovingObject stars[5];
+    Uint32 start_time = SDL_GetTicks();
+
+    for (int i = 0; i < 5; i++) {
+        stars[i].x = SCREEN_WIDTH/2 + (i-2)*150;
+        stars[i].y = SCREEN_HEIGHT/2;
+        stars[i].dx = ((float)rand() / RAND_MAX * 6.0f) - 3.0f;
+        stars[i].dy = ((float)rand() / RAND_MAX * 6.0f) - 3.0f;
+        stars[i].size = 40 + i*15;
+        stars[i].r = rand() % 256;
+        stars[i].g = rand() % 256;
+        stars[i].b = rand() % 256;
+        stars[i].rotation = 0;
+    }
+
+    while (running && (SDL_GetTicks() - start_time < DEMO_DURATION)) {
+        sdlgfx_clear();
+        sdlgfx_gradient_vertical_ex(50, 50, 50,
+                                  150 + sin(SDL_GetTicks() * 0.001) * 50,
+                                  150 + cos(SDL_GetTicks() * 0.001) * 50,
+                                  150 + sin(SDL_GetTicks() * 0.002) * 50,
+                                  0, 0, 0, 0, 0, 0, 2, SCREEN_WIDTH, SCREEN_HEIGHT, 0, 0, 0);
+
+        for (int i = 0; i < 5; i++) {
+            update_position(&stars[i], SCREEN_WIDTH, SCREEN_HEIGHT);
+
+            // Звезда из 7 вершин с шагом 3: контур пересекает сам себя
+            int xy[7 * 2];
+            for (int k = 0; k < 7; k++) {
+                float angle = stars[i].rotation + k * 3 * 2 * M_PI / 7;
+                xy[k * 2] = stars[i].x + (int)(cos(angle) * stars[i].size);
+                xy[k * 2 + 1] = stars[i].y + (int)(sin(angle) * stars[i].size);
+            }
+
+            // Чётные звёзды залиты по правилу nonzero, нечётные - even-odd (с "дырками")
+            sdlgfx_color(stars[i].r, stars[i].g, stars[i].b);
+            sdlgfx_fill_polygon(xy, 7, i % 2 == 0 ? SDLGFX_NONZERO : SDLGFX_EVEN_ODD);
+            sdlgfx_color(255, 255, 255);
+            sdlgfx_polygon(xy, 7);
+        }
+
+        draw_info_panel("sdlgfx_fill_polygon", "Self-Intersecting Stars: Nonzero / Even-Odd",
+                       DEMO_DURATION - (SDL_GetTicks() - start_time));
+        sdlgfx_flush();
         handle_input(&running);
     }
 }
@@ -559,6 +617,8 @@ void demo_pixel_effects() {
 
     // Включаем streaming texture для динамического обновления
     sdlgfx_set_streaming_texture(1);
+    // Три текстуры по кругу: следующий кадр пишется, пока предыдущий ещё копируется на экран
+    sdlgfx_set_texture_ring(3);
 
     // Буфер для хранения предыдущего состояния пикселей (для сглаживания)
     Uint32* pixel_buffer = (Uint32*)malloc(SCREEN_WIDTH * SCREEN_HEIGHT * sizeof(Uint32));
@@ -631,10 +691,10 @@ void demo_pixel_effects() {
         draw_info_panel("sdlgfx_pixel_gradient", "Plasma Effect with Streaming Texture",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 
+    sdlgfx_set_texture_ring(1);
     sdlgfx_set_streaming_texture(0); // Отключаем обратно
     free(pixel_buffer); // Освобождаем буфер
 }
@@ -690,7 +750,6 @@ void demo_text_collision() {
         draw_info_panel("sdlgfx_is_char_pixel", "Text Collision Detection",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -735,7 +794,6 @@ void demo_text_mathematical_waltz() {
         draw_info_panel("sdlgfx_string", "Mathematical Waltz of Letters and Numbers",
                        DEMO_DURATION - (SDL_GetTicks() - start_time));
         sdlgfx_flush();
-        SDL_Delay(16);
         handle_input(&running);
     }
 }
@@ -758,6 +816,7 @@ int main(int argc, char *argv[]) {
         return 1;
     }
 
+    sdlgfx_set_present_mode(SDLGFX_PRESENT_PACED, 60.0); // Ровные 60 кадров/с без SDL_Delay в циклах демо
     sdlgfx_open(SCREEN_WIDTH, SCREEN_HEIGHT, "SDLGFX Enhanced Demo",
                 SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     sdlgfx_clear_color(0, 0, 0);
@@ -801,6 +860,9 @@ int main(int argc, char *argv[]) {
         
         demo_arcs();
         if (!running) break;
+
+        demo_polygons();
+        if (!running) break;
         
         demo_text_collision();
         if (!running) break;
@@ -824,6 +886,11 @@ int main(int argc, char *argv[]) {
         handle_input(&running);
     }
 
+    SdlgfxFrameStats stats;
+    sdlgfx_get_frame_stats(&stats);
+    printf("Frames: %d, avg %.2f ms (min %.2f, max %.2f), %.1f fps, late: %d\n",
+           stats.frames, stats.avg_ms, stats.min_ms, stats.max_ms, stats.fps, stats.late);
+
     sdlgfx_close();
     SDL_Quit();
     return 0;
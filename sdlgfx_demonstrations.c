@@ -234,12 +234,15 @@ int main(int argc, char *argv[])
         return 1;                                                // Возвращаем код ошибки 1, указывающий на неудачное завершение программы
     }
 
+    sdlgfx_set_present_mode(SDLGFX_PRESENT_PACED, 40.0); // sdlgfx_flush() сам выдерживает 40 кадров в секунду по счетчику высокого разрешения
     sdlgfx_open(800, 600, "SDLGFX v0.1 - simple graphics library - Demo", // Открываем окно SDL с заданными параметрами - функция из sdlgfx.h
                 SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     // 800, 600 - ширина и высота окна
     // "SDLGFX v0.1 - simple graphics library - Demo" - заголовок окна
     // SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED - позиционирование окна по центру экрана
 
+    sdlgfx_set_deferred(1); // Записываем точки и линии в буфер команд, sdlgfx_flush() рисует их пакетами
+
     sdlgfx_clear_color(0, 0, 0); // Устанавливаем цвет фона для очистки экрана - черный цвет (RGB: 0, 0, 0) - функция из sdlgfx.h
     sdlgfx_clear();             // Очищаем экран, заливая его фоновым цветом - функция из sdlgfx.h
 
@@ -443,8 +446,7 @@ int main(int argc, char *argv[])
             // Выводим строку countdown на экран - функция sdlgfx_string из sdlgfx.h, смещено вниз
         }
 
-        sdlgfx_flush(); // Обновляем экран, отображая все нарисованное - функция из sdlgfx.h
-        SDL_Delay(25);  // Пауза 25 миллисекунд (примерно 40 кадров в секунду) для управления частотой кадров
+        sdlgfx_flush(); // Обновляем экран, отображая все нарисованное - функция из sdlgfx.h, и ждем следующего кадра (40 кадров в секунду)
     }
 
     sdlgfx_close(); // Закрываем окно SDL и освобождаем ресурсы - функция из sdlgfx.h
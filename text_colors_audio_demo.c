@@ -352,6 +352,120 @@ SDL_Color get_smooth_random_color() {
     current_random_color.b += (random_color_target.b - current_random_color.b) * random_color_interpolation_factor;
     return current_random_color; }
 
+// Кадр Белоусова-Жаботинского в буфер RGBA8888 (pitch в пикселях). Пишет только в pixels,
+// поэтому может работать в рабочем потоке sdlgfx_pipeline_start.
+void draw_bz_frame(Uint32 *pixels, int pitch, int width, int height, float time, int color_technique) {
+    (void)color_technique;
+    // 1. Предварительные вычисления
+    int num_centers = 3;
+    int centers_x[3] = {
+        (int)((float)width * 0.25f),
+        (int)((float)width * 0.75f),
+        (int)((float)width * 0.5f) };
+    int centers_y[3] = {
+        (int)((float)height * 0.25f),
+        (int)((float)height * 0.75f),
+        (int)((float)height * 0.5f) };
+    float wave_frequency = 0.00005f;  // 0.00005f;        0.025f  0.05f
+    float wave_speed = 0.04f;  // 0.04f;
+    const int STEP = 1; // 2   можем, но не используем
+
+#define SIN_LUT_SIZE 512 // Степень двойки (2^9)
+
+    static float sin_lut[SIN_LUT_SIZE];
+    static int lut_initialized = 0;
+    // 0. **Реализация _mm_abs_ps для SSE2**
+    inline __m128 _mm_abs_ps_sse2(__m128 x) {
+        __m128 sign_mask = _mm_set1_ps(-0.0f);
+        return _mm_andnot_ps(sign_mask, x); }
+    // Инициализация LUT для синусоиды
+    if (!lut_initialized) {
+        for (int i = 0; i < SIN_LUT_SIZE; ++i) {
+            float angle = (float)i / SIN_LUT_SIZE * 2.0f * M_PI;
+            sin_lut[i] = sinf(angle); }
+        lut_initialized = 1; }
+    // **5. Инициализация min_phase и max_phase для кадра**
+    float min_phase = 1e30f;
+    float max_phase = -1e30f;
+    // Основной цикл с векторизацией (SSE) и многопоточностью для всего экрана - [DISTANCE TYPE], schedule(static), LOGGING NORMALIZATION
+    #pragma omp parallel for collapse(2) schedule(static)
+    for (int y = 0; y < height; y += STEP) {
+        for (int x = 0; x < width; x += 4 * STEP) {
+            if (x + 4 * STEP > width) {
+                continue; }
+            __m128 x_vec = _mm_set_ps((float)(x + 3 * STEP), (float)(x + 2 * STEP), (float)(x + STEP), (float)x);
+            __m128 y_vec = _mm_set1_ps((float)y);
+            __m128 total_phase_vec = _mm_setzero_ps();
+            for (int i = 0; i < num_centers; i++) {
+                __m128 center_x_vec = _mm_set1_ps((float)centers_x[i]);
+                __m128 center_y_vec = _mm_set1_ps((float)centers_y[i]);
+                __m128 dx_vec = _mm_sub_ps(x_vec, center_x_vec);
+                __m128 dy_vec = _mm_sub_ps(y_vec, center_y_vec);
+                __m128 distance_squared_vec; // Объявляем здесь, чтобы переопределить ниже
+
+                // *** ВЫБЕРИТЕ ОДИН ИЗ ВАРИАНТОВ РАССТОЯНИЯ ДЛЯ ТЕСТИРОВАНИЯ ***
+                // *** ВАРИАНТ 1: МАНХЭТТЕНСКОЕ РАССТОЯНИЕ (ИСХОДНЫЙ КОД - ЗАКОММЕНТИРОВАН ДЛЯ НАЧАЛА) ***
+                // distance_squared_vec = _mm_add_ps(
+                //     _mm_abs_ps_sse2(dx_vec),
+                //     _mm_abs_ps_sse2(dy_vec)
+                // );
+                // *** ВАРИАНТ 2: ТОЛЬКО ГОРИЗОНТАЛЬНОЕ РАССТОЯНИЕ (ОЧЕНЬ ПРОСТО) ***
+                // distance_squared_vec = _mm_abs_ps_sse2(dx_vec);
+                // *** ВАРИАНТ 3: ТОЛЬКО ВЕРТИКАЛЬНОЕ РАССТОЯНИЕ (ОЧЕНЬ ПРОСТО) ***
+                // distance_squared_vec = _mm_abs_ps_sse2(dy_vec);
+                // *** ВАРИАНТ 4: СУММА АБСОЛЮТНЫХ ЗНАЧЕНИЙ КООРДИНАТ БЕЗ ВЫЧИТАНИЯ ЦЕНТРА (ЕЩЕ ПРОЩЕ) ***
+                // distance_squared_vec = _mm_add_ps(_mm_abs_ps_sse2(x_vec), _mm_abs_ps_sse2(y_vec));
+                // *** ВАРИАНТ 5: ПРОСТО СУММА КООРДИНАТ БЕЗ АБСОЛЮТНЫХ ЗНАЧЕНИЙ И ВЫЧИТАНИЯ ЦЕНТРА (САМОЕ ПРОСТОЕ, ГРАДИЕНТ) ***
+                // distance_squared_vec = _mm_add_ps(x_vec, y_vec);
+                // *** ВАРИАНТ 6: РАЗНОСТЬ КООРДИНАТ (ДИАГОНАЛЬНЫЙ ГРАДИЕНТ) ***
+                // distance_squared_vec = _mm_sub_ps(x_vec, y_vec);
+                // *** ВАРИАНТ 7: ИСХОДНОЕ ЕВКЛИДОВО РАССТОЯНИЕ (ДЛЯ СРАВНЕНИЯ) ***
+                 distance_squared_vec = _mm_add_ps(
+                     _mm_mul_ps(dx_vec, dx_vec),
+                     _mm_mul_ps(dy_vec, dy_vec)
+                 );
+                __m128 phase_input_vec = _mm_add_ps(
+                                             _mm_mul_ps(distance_squared_vec, _mm_set1_ps(wave_frequency)),
+                                             _mm_set1_ps(-time * wave_speed + i * 2.0f)
+                                         );
+                // Упрощённая синусоида через LUT без нормализации к [0, 2π]
+                __m128 lut_scale = _mm_set1_ps((float)SIN_LUT_SIZE / (2.0f * M_PI));
+                __m128 lut_index_vec = _mm_mul_ps(phase_input_vec, lut_scale);
+                float phase_inputs[4];
+                _mm_store_ps(phase_inputs, lut_index_vec);
+                for (int k = 0; k < 4; k++) {
+                    int idx = (int)phase_inputs[k] & (SIN_LUT_SIZE - 1); // Побитовое И вместо %
+                    if (idx < 0) {
+                        idx += SIN_LUT_SIZE; } // Обрабатываем отрицательные значения
+                    ((float*)&total_phase_vec)[k] += sin_lut[idx]; } }
+            // **6. Обновление min_phase и max_phase (ДО нормализации)**
+            float current_phases[4];
+            _mm_store_ps(current_phases, total_phase_vec);
+            for (int k = 0; k < 4; k++) {
+                if (current_phases[k] < min_phase) {
+                    min_phase = current_phases[k]; }
+                if (current_phases[k] > max_phase) {
+                    max_phase = current_phases[k]; } }
+            // Нормализация к [0, 1] - **ОСТАВЛЯЕМ ИСХОДНУЮ НОРМАЛИЗАЦИЮ ДЛЯ ВИДИМОГО РЕЗУЛЬТАТА**
+            __m128 normalized_phase_vec = _mm_add_ps(
+                                              _mm_mul_ps(total_phase_vec, _mm_set1_ps(0.5f / num_centers)), // Исходная нормализация   0.5f
+                                              _mm_set1_ps(0.5f)
+                                          );
+            normalized_phase_vec = _mm_max_ps(normalized_phase_vec, _mm_setzero_ps());
+            normalized_phase_vec = _mm_min_ps(normalized_phase_vec, _mm_set1_ps(1.0f));
+            float normalized_phases[4];
+            _mm_store_ps(normalized_phases, normalized_phase_vec);
+            // Заполнение пикселей с исходной палитрой
+            for (int k = 0; k < 4; k++) {
+                SDL_Color color = get_color_cycling_color(normalized_phases[k]);
+                Uint32 pixel_color = (255 << 24) | (color.r << 16) | (color.g << 8) | color.b;
+                int current_x = x + k * STEP;
+                const int max_x = (current_x + STEP < width) ? current_x + STEP : width;
+                const int max_y = (y + STEP < height) ? y + STEP : height;
+                for (int yy = y; yy < max_y; yy++) {
+                    for (int xx = current_x; xx < max_x; xx++) {
+                        pixels[yy * pitch + xx] = pixel_color; } } } } } }
+
 void draw_background(int width, int height, float time, int color_technique) {
     switch (color_technique) {
         case 0:
@@ -394,28 +508,6 @@ void draw_background(int width, int height, float time, int color_technique) {
             static SDL_Texture* temp_tex = NULL;
             static int tex_width = 0, tex_height = 0;
             static int frame_count = 0; // Статический счетчик кадров
-            // 1. Предварительные вычисления
-            int num_centers = 3;
-            int centers_x[3] = {
-                (int)((float)width * 0.25f),
-                (int)((float)width * 0.75f),
-                (int)((float)width * 0.5f) };
-            int centers_y[3] = {
-                (int)((float)height * 0.25f),
-                (int)((float)height * 0.75f),
-                (int)((float)height * 0.5f) };
-            float wave_frequency = 0.00005f;  // 0.00005f;        0.025f  0.05f
-            float wave_speed = 0.04f;  // 0.04f;
-            const int STEP = 1; // 2   можем, но не используем
-
-#define SIN_LUT_SIZE 512 // Степень двойки (2^9)
-
-            static float sin_lut[SIN_LUT_SIZE];
-            static int lut_initialized = 0;
-            // 0. **Реализация _mm_abs_ps для SSE2**
-            inline __m128 _mm_abs_ps_sse2(__m128 x) {
-                __m128 sign_mask = _mm_set1_ps(-0.0f);
-                return _mm_andnot_ps(sign_mask, x); }
             // 2. Создание или проверка текстуры
             if (!temp_tex || tex_width != width || tex_height != height) {
                 if (temp_tex) {
@@ -443,93 +535,7 @@ void draw_background(int width, int height, float time, int color_technique) {
                 SDL_FreeFormat(pixel_format);
                 break; }
             pitch /= sizeof(Uint32);
-            // Инициализация LUT для синусоиды
-            if (!lut_initialized) {
-                for (int i = 0; i < SIN_LUT_SIZE; ++i) {
-                    float angle = (float)i / SIN_LUT_SIZE * 2.0f * M_PI;
-                    sin_lut[i] = sinf(angle); }
-                lut_initialized = 1; }
-            // **5. Инициализация min_phase и max_phase для кадра**
-            float min_phase = 1e30f;
-            float max_phase = -1e30f;
-            // Основной цикл с векторизацией (SSE) и многопоточностью для всего экрана - [DISTANCE TYPE], schedule(static), LOGGING NORMALIZATION
-            #pragma omp parallel for collapse(2) schedule(static)
-            for (int y = 0; y < height; y += STEP) {
-                for (int x = 0; x < width; x += 4 * STEP) {
-                    if (x + 4 * STEP > width) {
-                        continue; }
-                    __m128 x_vec = _mm_set_ps((float)(x + 3 * STEP), (float)(x + 2 * STEP), (float)(x + STEP), (float)x);
-                    __m128 y_vec = _mm_set1_ps((float)y);
-                    __m128 total_phase_vec = _mm_setzero_ps();
-                    for (int i = 0; i < num_centers; i++) {
-                        __m128 center_x_vec = _mm_set1_ps((float)centers_x[i]);
-                        __m128 center_y_vec = _mm_set1_ps((float)centers_y[i]);
-                        __m128 dx_vec = _mm_sub_ps(x_vec, center_x_vec);
-                        __m128 dy_vec = _mm_sub_ps(y_vec, center_y_vec);
-                        __m128 distance_squared_vec; // Объявляем здесь, чтобы переопределить ниже
-
-                        // *** ВЫБЕРИТЕ ОДИН ИЗ ВАРИАНТОВ РАССТОЯНИЯ ДЛЯ ТЕСТИРОВАНИЯ ***
-                        // *** ВАРИАНТ 1: МАНХЭТТЕНСКОЕ РАССТОЯНИЕ (ИСХОДНЫЙ КОД - ЗАКОММЕНТИРОВАН ДЛЯ НАЧАЛА) ***
-                        // distance_squared_vec = _mm_add_ps(
-                        //     _mm_abs_ps_sse2(dx_vec),
-                        //     _mm_abs_ps_sse2(dy_vec)
-                        // );
-                        // *** ВАРИАНТ 2: ТОЛЬКО ГОРИЗОНТАЛЬНОЕ РАССТОЯНИЕ (ОЧЕНЬ ПРОСТО) ***
-                        // distance_squared_vec = _mm_abs_ps_sse2(dx_vec);
-                        // *** ВАРИАНТ 3: ТОЛЬКО ВЕРТИКАЛЬНОЕ РАССТОЯНИЕ (ОЧЕНЬ ПРОСТО) ***
-                        // distance_squared_vec = _mm_abs_ps_sse2(dy_vec);
-                        // *** ВАРИАНТ 4: СУММА АБСОЛЮТНЫХ ЗНАЧЕНИЙ КООРДИНАТ БЕЗ ВЫЧИТАНИЯ ЦЕНТРА (ЕЩЕ ПРОЩЕ) ***
-                        // distance_squared_vec = _mm_add_ps(_mm_abs_ps_sse2(x_vec), _mm_abs_ps_sse2(y_vec));
-                        // *** ВАРИАНТ 5: ПРОСТО СУММА КООРДИНАТ БЕЗ АБСОЛЮТНЫХ ЗНАЧЕНИЙ И ВЫЧИТАНИЯ ЦЕНТРА (САМОЕ ПРОСТОЕ, ГРАДИЕНТ) ***
-                        // distance_squared_vec = _mm_add_ps(x_vec, y_vec);
-                        // *** ВАРИАНТ 6: РАЗНОСТЬ КООРДИНАТ (ДИАГОНАЛЬНЫЙ ГРАДИЕНТ) ***
-                        // distance_squared_vec = _mm_sub_ps(x_vec, y_vec);
-                        // *** ВАРИАНТ 7: ИСХОДНОЕ ЕВКЛИДОВО РАССТОЯНИЕ (ДЛЯ СРАВНЕНИЯ) ***
-                         distance_squared_vec = _mm_add_ps(
-                             _mm_mul_ps(dx_vec, dx_vec),
-                             _mm_mul_ps(dy_vec, dy_vec)
-                         );
-                        __m128 phase_input_vec = _mm_add_ps(
-                                                     _mm_mul_ps(distance_squared_vec, _mm_set1_ps(wave_frequency)),
-                                                     _mm_set1_ps(-time * wave_speed + i * 2.0f)
-                                                 );
-                        // Упрощённая синусоида через LUT без нормализации к [0, 2π]
-                        __m128 lut_scale = _mm_set1_ps((float)SIN_LUT_SIZE / (2.0f * M_PI));
-                        __m128 lut_index_vec = _mm_mul_ps(phase_input_vec, lut_scale);
-                        float phase_inputs[4];
-                        _mm_store_ps(phase_inputs, lut_index_vec);
-                        for (int k = 0; k < 4; k++) {
-                            int idx = (int)phase_inputs[k] & (SIN_LUT_SIZE - 1); // Побитовое И вместо %
-                            if (idx < 0) {
-                                idx += SIN_LUT_SIZE; } // Обрабатываем отрицательные значения
-                            ((float*)&total_phase_vec)[k] += sin_lut[idx]; } }
-                    // **6. Обновление min_phase и max_phase (ДО нормализации)**
-                    float current_phases[4];
-                    _mm_store_ps(current_phases, total_phase_vec);
-                    for (int k = 0; k < 4; k++) {
-                        if (current_phases[k] < min_phase) {
-                            min_phase = current_phases[k]; }
-                        if (current_phases[k] > max_phase) {
-                            max_phase = current_phases[k]; } }
-                    // Нормализация к [0, 1] - **ОСТАВЛЯЕМ ИСХОДНУЮ НОРМАЛИЗАЦИЮ ДЛЯ ВИДИМОГО РЕЗУЛЬТАТА**
-                    __m128 normalized_phase_vec = _mm_add_ps(
-                                                      _mm_mul_ps(total_phase_vec, _mm_set1_ps(0.5f / num_centers)), // Исходная нормализация   0.5f
-                                                      _mm_set1_ps(0.5f)
-                                                  );
-                    normalized_phase_vec = _mm_max_ps(normalized_phase_vec, _mm_setzero_ps());
-                    normalized_phase_vec = _mm_min_ps(normalized_phase_vec, _mm_set1_ps(1.0f));
-                    float normalized_phases[4];
-                    _mm_store_ps(normalized_phases, normalized_phase_vec);
-                    // Заполнение пикселей с исходной палитрой
-                    for (int k = 0; k < 4; k++) {
-                        SDL_Color color = get_color_cycling_color(normalized_phases[k]);
-                        Uint32 pixel_color = (255 << 24) | (color.r << 16) | (color.g << 8) | color.b;
-                        int current_x = x + k * STEP;
-                        const int max_x = (current_x + STEP < width) ? current_x + STEP : width;
-                        const int max_y = (y + STEP < height) ? y + STEP : height;
-                        for (int yy = y; yy < max_y; yy++) {
-                            for (int xx = current_x; xx < max_x; xx++) {
-                                pixels[yy * pitch + xx] = pixel_color; } } } } }
+            draw_bz_frame(pixels, pitch, width, height, time, color_technique);
             /*
                 // **7. Вывод лога в консоль ПОСЛЕ цикла отрисовки**
                 frame_count++;
@@ -583,7 +589,9 @@ void draw_massive_scene(int width, int height, float time, int color_technique)
     //    функцией `draw_background` и сохранена в `sdlgfx_texture`.
     //    Фон обновляется только тогда, когда это необходимо (например, при смене цветовой техники
     //    или если фон должен динамически меняться каждый кадр).
-    SDL_RenderCopy(sdlgfx_renderer, sdlgfx_texture, NULL, NULL);
+    //    Если фон считает рабочий поток (sdlgfx_pipeline_start), выводится его последний готовый кадр.
+    if (!sdlgfx_pipeline_draw()) {
+        SDL_RenderCopy(sdlgfx_renderer, sdlgfx_texture, NULL, NULL); }
     // 2. Условное рисование сетки:
     //    Этот блок кода рисует сетку поверх фона, но только если текущая цветовая техника
     //    НЕ является "COLOR: CYCLING PALETTE" (индекс 1).
@@ -700,6 +708,7 @@ int main(int argc, char *argv[]) {
         SDL_Log("Failed to open audio device: %s", SDL_GetError());
         SDL_Quit();
         return 1; }
+    sdlgfx_set_present_mode(SDLGFX_PRESENT_PACED, 60.0); // Кадры выдерживает sdlgfx_flush() по SDL_GetPerformanceCounter
     sdlgfx_open(WINDOW_WIDTH, WINDOW_HEIGHT, "Sound & Color Demo", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED);
     sdlgfx_clear_color(0, 0, 0);
     SDL_PauseAudioDevice(device, 0);
@@ -717,12 +726,9 @@ int main(int argc, char *argv[]) {
     float time = 0.0;
     int running = 1;
     technique_start_time = SDL_GetTicks();
-    Uint32 frame_start, frame_time;
-    const int target_fps = 60;
-    const Uint32 frame_delay = 1000 / target_fps;
     sdlgfx_update_texture(draw_background, WINDOW_WIDTH, WINDOW_HEIGHT, time, current_color_technique, 1);
+    int bz_pipeline = 0; // Фон BZ считается в рабочем потоке, пока показывается предыдущий кадр
     while (running) {
-        frame_start = SDL_GetTicks();
         SDL_Event e;
         while (SDL_PollEvent(&e)) {
             if (e.type == SDL_QUIT || (e.type == SDL_KEYDOWN && e.key.keysym.scancode == SDL_SCANCODE_Q)) {
@@ -763,7 +769,12 @@ int main(int argc, char *argv[]) {
                         printf("Switched to color technique: %s\n", color_technique_names[current_color_technique]);
                         break; } } }
         time = SDL_GetTicks() / 1000.0f;
-        int update_texture = needs_update_every_frame(current_color_technique);
+        if (current_color_technique == 1 && !bz_pipeline) {
+            bz_pipeline = sdlgfx_pipeline_start(draw_bz_frame, current_color_technique); }
+        else if (current_color_technique != 1 && bz_pipeline) {
+            sdlgfx_pipeline_stop();
+            bz_pipeline = 0; }
+        int update_texture = needs_update_every_frame(current_color_technique) && !bz_pipeline;
         sdlgfx_update_texture(draw_background, WINDOW_WIDTH, WINDOW_HEIGHT, time, current_color_technique, update_texture);
         sdlgfx_clear();
         draw_massive_scene(WINDOW_WIDTH, WINDOW_HEIGHT, time, current_color_technique);
@@ -783,10 +794,7 @@ int main(int argc, char *argv[]) {
             sdlgfx_color(0, 0, 0);
             sdlgfx_color(255, 255, 255);
             sdlgfx_string(10, WINDOW_HEIGHT - 15, countdown_text); }
-        sdlgfx_flush();
-        frame_time = SDL_GetTicks() - frame_start;
-        if (frame_time < frame_delay) {
-            SDL_Delay(frame_delay - frame_time); } }
+        sdlgfx_flush(); }
     SDL_PauseAudioDevice(device, 1);
     SDL_CloseAudioDevice(device);
     sdlgfx_close();